@@ -0,0 +1,137 @@
+//! Macro-benchmarks driving the `examples/` programs end to end.
+//!
+//! Each program is compiled once with [CodeGen] and the C toolchain during
+//! setup; the iterations then time execution only, so the numbers are
+//! comparable run-to-run. The interpreter example reads stdin, so it runs
+//! as a subprocess of the `relic` binary instead (its timing includes the
+//! JIT compile of the source). Run with `cargo bench`.
+
+use std::{
+    collections::HashMap,
+    io::Write,
+    process::{Command, Stdio},
+    sync::Once,
+};
+
+use criterion::{Criterion, criterion_group, criterion_main};
+use libloading::Library;
+use relic::{
+    compile::{CodeGen, compile},
+    node::Ast,
+    preprocess::PreProcess,
+    rt_pop, rt_start,
+};
+
+/// [rt_start] panics when the top environment already exists, so start the
+/// runtime once for all benchmark functions.
+static START: Once = Once::new();
+fn ensure_started() {
+    START.call_once(|| rt_start());
+}
+
+/// Compile a Lisp source to a shared object exporting `int {name}()` and
+/// load it. Mirrors the JIT pipeline in `src/package.rs`.
+fn compile_source(source: &str, name: &str) -> Library {
+    let mut ast = Ast::new();
+    let node = ast.parse_str(source).unwrap();
+    let node = ast.preprocess(node, &mut HashMap::new()).unwrap();
+
+    let mut codegen = CodeGen::new_library(name.to_string());
+    compile(&mut ast, node, &mut codegen, false).unwrap();
+
+    std::fs::create_dir_all("/tmp/relic_bench").unwrap();
+    let c_source_name = format!("/tmp/relic_bench/{name}.c");
+    let lib_full_name = format!("/tmp/relic_bench/{name}.relic");
+    std::fs::write(&c_source_name, codegen.to_string()).unwrap();
+
+    let status = Command::new("gcc")
+        .args([
+            "-Ic_runtime",
+            "-shared",
+            "-fPIC",
+            "-O3",
+            "-o",
+            &lib_full_name,
+            &c_source_name,
+            #[cfg(target_os = "macos")]
+            "-Wl,-undefined,dynamic_lookup",
+        ])
+        .status()
+        .unwrap();
+    assert!(status.success());
+
+    unsafe { Library::new(&lib_full_name) }.unwrap()
+}
+
+/// Run the compiled program's top-level function and drop its result.
+fn run_library(lib: &Library, name: &str) {
+    let func: libloading::Symbol<unsafe extern "C" fn() -> i32> =
+        unsafe { lib.get(name.as_bytes()) }.unwrap();
+    assert_eq!(unsafe { func() }, 0);
+    rt_pop();
+}
+
+/// `examples/3.27.lisp`: association tables and a memoized fib.
+fn bench_example_3_27(c: &mut Criterion) {
+    ensure_started();
+    let source = std::fs::read_to_string("examples/3.27.lisp").unwrap();
+    let lib = compile_source(&source, "bench_3_27");
+    c.bench_function("example/3.27", |b| {
+        b.iter(|| run_library(&lib, "bench_3_27"))
+    });
+}
+
+/// The tail-recursive loop from `examples/loop.lisp`, bounded so an
+/// iteration terminates and without the per-step I/O.
+fn bench_example_loop(c: &mut Criterion) {
+    ensure_started();
+    let source = "(define (loop x) (if (= x 0) 'done (loop (- x 1)))) (loop 10000)";
+    let lib = compile_source(source, "bench_loop");
+    let mut group = c.benchmark_group("example");
+    group.sample_size(10);
+    group.bench_function("loop_10k", |b| {
+        b.iter(|| run_library(&lib, "bench_loop"))
+    });
+    group.finish();
+}
+
+/// `examples/interpreter.lisp` evaluating a fib/map program, driven through
+/// the `relic` binary with the script piped to stdin.
+fn bench_example_interpreter(c: &mut Criterion) {
+    let script = br#"
+(define fib
+  (lambda (x)
+    (cond ((= x 0) 0)
+          ((= x 1) 1)
+          ('t (+ (fib (- x 2)) (fib (- x 1)))))))
+(define map
+  (lambda (f l)
+    (cond ((eq? l '()) '())
+          ('t (cons (f (car l))
+                    (map f (cdr l)))))))
+(map fib '(1 2 3 4 5 6 7 8 9 10))
+nil"#;
+    let mut group = c.benchmark_group("example");
+    group.sample_size(10);
+    group.bench_function("interpreter", |b| {
+        b.iter(|| {
+            let mut cmd = Command::new(env!("CARGO_BIN_EXE_relic"))
+                .args(["run", "-i", "examples/interpreter.lisp"])
+                .stdin(Stdio::piped())
+                .stdout(Stdio::null())
+                .spawn()
+                .unwrap();
+            cmd.stdin.take().unwrap().write_all(script).unwrap();
+            assert!(cmd.wait().unwrap().success());
+        })
+    });
+    group.finish();
+}
+
+criterion_group!(
+    benches,
+    bench_example_3_27,
+    bench_example_loop,
+    bench_example_interpreter
+);
+criterion_main!(benches);
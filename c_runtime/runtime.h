@@ -6,17 +6,48 @@
 
 // Misc
 extern void rt_start();
+// rt_start with the heap pre-sized to at least `size` node slots. The
+// RELIC_HEAP_SIZE and RELIC_HEAP_GROWTH environment variables configure the
+// initial size and growth factor without recompiling.
+extern void rt_start_with_heap(size_t size);
+extern void rt_reserve(size_t size);
 extern void rt_import(const char *name);
+// Heap images: rt_save_image records the warmed runtime as a manifest of
+// its compiled units; rt_restore_image replays it from the binary cache on
+// a freshly started runtime, skipping the C toolchain.
+extern void rt_save_image(const char *path);
+extern void rt_restore_image(const char *path);
 
 // Predicate
 extern int rt_is_symbol(size_t index);
 
+// Interned symbols
+//
+// Compiled units intern every symbol name once at startup and pass the
+// returned id to the *_id functions below instead of a C string.
+extern size_t rt_intern(const char *name);
+extern void rt_new_symbol_id(size_t id);
+extern void rt_define_id(size_t id, size_t value);
+extern void rt_set_id(size_t id, size_t value);
+extern size_t rt_get_id(size_t id);
+
 // Constructor
 extern void rt_new_symbol(const char *name);
 extern void rt_new_integer(long long value);
 extern void rt_new_float(double value);
 extern void rt_new_constant(const char *expr);
 
+// Constant pool
+//
+// Compiled units pool every quoted literal at startup and fetch the node
+// by the returned handle afterwards. `handle` is the value the pooling
+// site last got back — (size_t)-1 on its very first run — kept in a
+// per-module static; the handle is process-wide and each runtime context
+// parses its own copy of the literal under it, so re-running a startup
+// block is idempotent no matter which context executes it.
+extern size_t rt_pool_constant(size_t handle, const char *expr);
+extern size_t rt_get_constant(size_t handle);
+
 // Getter and setter
 extern long long rt_get_integer(size_t index);
 extern double rt_get_float(size_t index);
@@ -32,31 +63,79 @@ extern size_t rt_top(void);
 extern void rt_swap(void);
 
 // IO
-extern char *rt_display_node_idx(size_t index);
+//
+// The returned string lives in a buffer the runtime reuses on the next
+// call; do not free it and copy it out if it must survive.
+extern const char *rt_display_node_idx(size_t index);
 extern void rt_read();
 
 // Environment
 extern void rt_move_to_env(size_t env);
+extern void rt_save_env(void);
+extern void rt_restore_env(void);
+extern void rt_drop_frame(void);
 extern size_t rt_current_env();
 extern void rt_define(const char *name, size_t value);
 extern void rt_set(const char *name, size_t value);
 extern size_t rt_get(const char *name);
+extern size_t rt_get_local(size_t depth, size_t slot);
+
+// Inlined primitives. Each pops its operands from the stack and pushes the
+// result, like the corresponding rt_apply dispatch would.
+extern void rt_car(void);
+extern void rt_cdr(void);
+extern void rt_cons(void);
+extern void rt_add2(void);
+extern void rt_sub2(void);
+extern void rt_mul2(void);
+extern void rt_new_list(size_t n);
 
 // Closures
 extern void rt_apply();
 extern void rt_new_closure(const char *name, void (*func)(void), size_t nargs,
-                           int variadic);
+                           int variadic, int escapes);
 extern void rt_prepare_args(size_t cid);
 extern void rt_list_to_stack();
 typedef void (*c_func)();
 extern c_func rt_get_c_func(size_t cid);
 
+// Trampoline
+//
+// A call in tail position prepares the callee's environment, stores the
+// callee with rt_tail_call and falls out of the current function; the
+// nearest enclosing driver loop bounces through rt_next_call until no call
+// is pending. Deep self-recursion therefore runs in constant C stack.
+extern void rt_tail_call(c_func func);
+extern c_func rt_next_call(void);
+
+// Runtime contexts
+//
+// Every rt_* call resolves to the calling thread's current context; threads
+// that never enter one share the process-wide default. A context must only
+// be used by one thread at a time.
+typedef void *rt_context;
+extern rt_context rt_context_new(size_t heap_size);
+extern void rt_context_enter(rt_context ctx);
+extern rt_context rt_context_current(void);
+
 // Debug information
 extern void rt_evaluated(const char *name, int optimized);
+// The handle round-trips through a per-module static exactly like
+// rt_pool_constant's.
+extern size_t rt_add_dbg_info(size_t handle, const char *text);
+extern void rt_evaluated_id(size_t id, int optimized);
 extern void rt_breakpoint();
+extern char *rt_gc_stats(void);
+extern char *rt_dump_profile(void);
 
 // Root registers
 extern void rt_add_root(const char *name, size_t value);
 extern void rt_set_root(const char *name, size_t value);
 extern size_t rt_get_root(const char *name);
 extern size_t rt_remove_root(const char *name);
+
+// Runtime registers. GC roots like the named roots above, but addressed by
+// index so the calling convention pays no hashing per application.
+#define RT_REG_CLOSURE 0
+extern void rt_reg_set(size_t reg, size_t value);
+extern size_t rt_reg_get(size_t reg);
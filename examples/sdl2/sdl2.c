@@ -195,49 +195,49 @@ int sdl2() {
   define_sdl_constant("SDL_WINDOWPOS_CENTERED", SDL_WINDOWPOS_CENTERED);
 
   // Register SDL functions
-  rt_new_closure("sdl_init", sdl_init_wrapper, 1, false);
+  rt_new_closure("sdl_init", sdl_init_wrapper, 1, false, 0);
   rt_define("sdl-init", rt_pop());
 
-  rt_new_closure("sdl_create_window", sdl_create_window_wrapper, 6, false);
+  rt_new_closure("sdl_create_window", sdl_create_window_wrapper, 6, false, 0);
   rt_define("sdl-create-window", rt_pop());
 
   rt_new_closure("sdl_get_window_surface", sdl_get_window_surface_wrapper, 1,
-                 false);
+                 false, 0);
   rt_define("sdl-get-window-surface", rt_pop());
 
-  rt_new_closure("sdl_create_renderer", sdl_create_renderer_wrapper, 1, false);
+  rt_new_closure("sdl_create_renderer", sdl_create_renderer_wrapper, 1, false, 0);
   rt_define("sdl-create-renderer", rt_pop());
 
-  rt_new_closure("sdl_fill_rect", sdl_fill_rect_wrapper, 4, false);
+  rt_new_closure("sdl_fill_rect", sdl_fill_rect_wrapper, 4, false, 0);
   rt_define("sdl-fill-rect", rt_pop());
 
-  rt_new_closure("sdl_fill_rect_xywh", sdl_fill_rect_xywh_wrapper, 8, false);
+  rt_new_closure("sdl_fill_rect_xywh", sdl_fill_rect_xywh_wrapper, 8, false, 0);
   rt_define("sdl-fill-rect-xywh", rt_pop());
 
-  rt_new_closure("sdl_draw_line", sdl_draw_line_wrapper, 5, false);
+  rt_new_closure("sdl_draw_line", sdl_draw_line_wrapper, 5, false, 0);
   rt_define("sdl-draw-line", rt_pop());
 
-  rt_new_closure("sdl_render_present", sdl_render_present_wrapper, 1, false);
+  rt_new_closure("sdl_render_present", sdl_render_present_wrapper, 1, false, 0);
   rt_define("sdl-render-present", rt_pop());
 
   rt_new_closure("sdl_update_window_surface", sdl_update_window_surface_wrapper,
-                 1, false);
+                 1, false, 0);
   rt_define("sdl-update-window-surface", rt_pop());
 
-  rt_new_closure("sdl_delay", sdl_delay_wrapper, 1, false);
+  rt_new_closure("sdl_delay", sdl_delay_wrapper, 1, false, 0);
   rt_define("sdl-delay", rt_pop());
 
-  rt_new_closure("sdl_poll_event", sdl_poll_event_wrapper, 0, false);
+  rt_new_closure("sdl_poll_event", sdl_poll_event_wrapper, 0, false, 0);
   rt_define("sdl-poll-event", rt_pop());
 
   rt_new_closure("sdl_destroy_renderer", sdl_destroy_renderer_wrapper, 1,
-                 false);
+                 false, 0);
   rt_define("sdl-destroy-renderer", rt_pop());
 
-  rt_new_closure("sdl_destroy_window", sdl_destroy_window_wrapper, 1, false);
+  rt_new_closure("sdl_destroy_window", sdl_destroy_window_wrapper, 1, false, 0);
   rt_define("sdl-destroy-window", rt_pop());
 
-  rt_new_closure("sdl_quit", sdl_quit_wrapper, 0, false);
+  rt_new_closure("sdl_quit", sdl_quit_wrapper, 0, false, 0);
   rt_define("sdl-quit", rt_pop());
 
   return 0;
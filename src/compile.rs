@@ -4,8 +4,9 @@ use std::{collections::HashMap, fmt::Display};
 
 use crate::{
     lexer::Number,
-    node::{Node, Pattern},
-    symbol::{SpecialForm, Symbol},
+    node::{Ast, Node, NodeId},
+    optimize::Optimize,
+    symbol::{SpecialForm, Symbol, atom_name, intern},
     util::{get_n_params, inc, vectorize},
 };
 
@@ -35,6 +36,18 @@ pub struct CodeGen {
     ty: CodeGenType,
     /// Closures. Values are function body without boilerplate.
     closures: HashMap<usize, String>,
+    /// Symbols mentioned by the generated code. Values are ids of the
+    /// `sym_*` statics that hold the interned ids at run-time.
+    symbols: HashMap<String, usize>,
+    /// Quoted literals in the generated code. Values are ids of the
+    /// `const_*` statics that hold the constant-pool handles at run-time.
+    constants: HashMap<String, usize>,
+    /// Expression texts emitted as debug information. Values are ids of
+    /// the `dbg_*` statics that hold the run-time handles.
+    dbg_texts: HashMap<String, usize>,
+    /// Ids of the lambdas enclosing the code being generated, innermost
+    /// last. Used to turn positional parameters into lexical addresses.
+    scope: Vec<usize>,
     /// Body of the function the generator is writing.
     body: String,
 }
@@ -44,6 +57,10 @@ impl CodeGen {
         CodeGen {
             ty: CodeGenType::Main,
             closures: HashMap::new(),
+            symbols: HashMap::new(),
+            constants: HashMap::new(),
+            dbg_texts: HashMap::new(),
+            scope: vec![],
             body: String::new(),
         }
     }
@@ -51,6 +68,10 @@ impl CodeGen {
         CodeGen {
             ty: CodeGenType::Internal(id),
             closures: HashMap::new(),
+            symbols: HashMap::new(),
+            constants: HashMap::new(),
+            dbg_texts: HashMap::new(),
+            scope: vec![],
             body: String::new(),
         }
     }
@@ -58,6 +79,10 @@ impl CodeGen {
         CodeGen {
             ty: CodeGenType::Library(name),
             closures: HashMap::new(),
+            symbols: HashMap::new(),
+            constants: HashMap::new(),
+            dbg_texts: HashMap::new(),
+            scope: vec![],
             body: String::new(),
         }
     }
@@ -65,10 +90,55 @@ impl CodeGen {
     fn append_code(&mut self, code: &str) {
         self.body += code;
     }
+    /// Return the name of the static variable that holds `name`'s interned
+    /// symbol id, allocating a new one the first time `name` is seen.
+    ///
+    /// The variable is filled in by `rt_intern` at the start of the compiled
+    /// unit (see the [Display] implementation), so symbol references in the
+    /// body pass an integer id instead of a C string.
+    fn symbol_id(&mut self, name: &str) -> String {
+        // `inc` keeps ids unique across nested generators, so `merge` can
+        // union the tables without renaming variables.
+        let id = *self.symbols.entry(name.to_string()).or_insert_with(inc);
+        format!("sym_{id}")
+    }
+    /// Return the name of the static variable that holds the constant-pool
+    /// handle of the quoted literal `expr`, allocating a new one the first
+    /// time the literal is seen.
+    ///
+    /// The variable is filled in by `rt_pool_constant` at the start of the
+    /// compiled unit, so evaluating the quote becomes a pool fetch instead of
+    /// re-parsing the literal.
+    fn constant_id(&mut self, expr: &str) -> String {
+        let id = *self.constants.entry(expr.to_string()).or_insert_with(inc);
+        format!("const_{id}")
+    }
+    /// Return the name of the static variable that holds the debug-info
+    /// handle of the expression text `expr`, allocating a new one the first
+    /// time the text is seen.
+    ///
+    /// The variable is filled in by `rt_add_dbg_info` at the start of the
+    /// compiled unit, so evaluation sites pass an integer handle instead of
+    /// embedding (and crossing with) the source text on every evaluation.
+    fn dbg_info_id(&mut self, expr: &str) -> String {
+        let id = *self.dbg_texts.entry(expr.to_string()).or_insert_with(inc);
+        format!("dbg_{id}")
+    }
+    /// If `name` is a positional parameter of an enclosing lambda, return
+    /// the code that loads it through its lexical address, i.e. two array
+    /// indexes instead of a hash lookup per environment frame.
+    fn local_ref(&self, name: &str) -> Option<String> {
+        let (slot, id) = parse_positional(name)?;
+        let depth = self.scope.iter().rev().position(|scope_id| *scope_id == id)?;
+        Some(format!("rt_push(rt_get_local({depth}, {slot}));"))
+    }
     /// Merge the generator of a function created by this generator's function.
     fn merge(&mut self, func: Self) {
         if let CodeGenType::Internal(id) = func.ty {
             self.closures.extend(func.closures);
+            self.symbols.extend(func.symbols);
+            self.constants.extend(func.constants);
+            self.dbg_texts.extend(func.dbg_texts);
             assert!(self.closures.insert(id, func.body).is_none());
         } else {
             panic!("Merging top-level generator: {func}");
@@ -76,21 +146,45 @@ impl CodeGen {
     }
 }
 
+/// Whether the expression creates a closure anywhere inside, i.e. whether a
+/// call environment visible to it can be captured and outlive the call.
+/// Quoted data is skipped: it is never compiled.
+fn creates_closure(ast: &Ast, node: NodeId) -> bool {
+    match *ast.get(node) {
+        Node::SpecialForm(SpecialForm::Lambda) => true,
+        Node::Pair(car, cdr) => {
+            if let Node::SpecialForm(SpecialForm::Quote) = *ast.get(car) {
+                return false;
+            }
+            creates_closure(ast, car) || creates_closure(ast, cdr)
+        }
+        _ => false,
+    }
+}
+
+/// Parse a positional parameter name of the form `#<slot>_func_<lambda_id>`
+/// produced by the `Lambda` arm below.
+fn parse_positional(name: &str) -> Option<(usize, usize)> {
+    let rest = name.strip_prefix('#')?;
+    let (slot, id) = rest.split_once("_func_")?;
+    Some((slot.parse().ok()?, id.parse().ok()?))
+}
+
 macro_rules! return_nil {
     ($codegen:expr, $ctx:expr) => {
         if !$ctx.drop_ret {
-            $codegen.append_code("rt_new_symbol(\"nil\");");
+            let var = $codegen.symbol_id("nil");
+            $codegen.append_code(&format!("rt_new_symbol_id({var});"));
         }
     };
 }
 
 macro_rules! set_family {
-    ($func_name:expr, $target:expr, $cdr:expr, $codegen:expr, $ctx:expr, $dbg_info:expr) => {{
-        let params = get_n_params($cdr.clone(), 2)?;
-        let sym = &params[0];
-        let expr = &params[1];
-        let name = sym.borrow().as_user_symbol()?;
-        expr.borrow().compile(
+    ($func_name:expr, $target:expr, $ast:expr, $cdr:expr, $codegen:expr, $ctx:expr, $dbg_info:expr) => {{
+        let params = get_n_params($ast, $cdr, 2)?;
+        let name = $ast.as_user_symbol(params[0])?;
+        params[1].compile(
+            $ast,
             $codegen,
             ContexInfo {
                 drop_env: false,
@@ -98,7 +192,8 @@ macro_rules! set_family {
             },
             $dbg_info,
         )?;
-        $codegen.append_code(&format!("rt_{}({}, rt_pop());", $func_name, $target(name)));
+        let var = $codegen.symbol_id(&name);
+        $codegen.append_code(&format!("rt_{}({}, rt_pop());", $func_name, $target(var)));
         return_nil!($codegen, $ctx);
         Ok(())
     }};
@@ -106,20 +201,60 @@ macro_rules! set_family {
 
 impl Display for CodeGen {
     fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
-        let (func_name, start_code) = match &self.ty {
+        let (func_name, mut start_code) = match &self.ty {
             CodeGenType::Internal(id) => panic!("Writing internal closure {id}"),
             CodeGenType::Main => ("main".to_string(), "rt_start();".to_string()),
             CodeGenType::Library(name) => (name.to_string(), String::new()),
         };
         let main_body = &self.body;
 
+        writeln!(f, "#include\"runtime.h\"")?;
         for name in self.closures.keys() {
             writeln!(f, "static void func_{name}();")?;
         }
+        // Symbols are interned once when the unit starts; the body refers to
+        // them by id through these statics.
+        let mut symbols: Vec<_> = self.symbols.iter().collect();
+        symbols.sort_by_key(|(_, id)| **id);
+        for (_, id) in &symbols {
+            writeln!(f, "static size_t sym_{id};")?;
+        }
+        for (name, id) in &symbols {
+            start_code += &format!("sym_{id} = rt_intern(\"{name}\");");
+        }
+        // Quoted literals are parsed once into the constant pool when the
+        // unit starts; each evaluation is then a pool fetch.
+        let mut constants: Vec<_> = self.constants.iter().collect();
+        constants.sort_by_key(|(_, id)| **id);
+        for (_, id) in &constants {
+            writeln!(f, "static size_t const_{id} = (size_t)-1;")?;
+        }
+        for (expr, id) in &constants {
+            start_code += &format!("const_{id} = rt_pool_constant(const_{id}, \"{expr}\");");
+        }
+        // Debug-info texts are registered once when the unit starts; the
+        // body passes the handle through these statics, so the text only
+        // crosses the FFI when the debugger fires.
+        let mut dbg_texts: Vec<_> = self.dbg_texts.iter().collect();
+        dbg_texts.sort_by_key(|(_, id)| **id);
+        for (_, id) in &dbg_texts {
+            writeln!(f, "static size_t dbg_{id} = (size_t)-1;")?;
+        }
+        for (expr, id) in &dbg_texts {
+            start_code += &format!("dbg_{id} = rt_add_dbg_info(dbg_{id}, \"{expr}\");");
+        }
+        // The startup block runs on every execution. The statics above are
+        // per-module and the dynamic loader shares one copy of a module
+        // across every runtime context that loads it, so a module-level
+        // "already started" guard would leave a later context reading
+        // pool entries it never filled. Instead the handles are
+        // process-wide ids a site allocates on its first run and passes
+        // back afterwards: re-running lets each context materialize its
+        // own copy of the literals under those ids, and is otherwise a
+        // bounds check per literal.
         writeln!(
             f,
             r#"
-#include"runtime.h"
 int {func_name}() {{
     {start_code}
     {main_body}
@@ -168,9 +303,16 @@ macro_rules! no_drop {
     };
 }
 
-/// Calls [Node::compile] with no optimization at the top level.
-pub fn compile(node: &Node, codegen: &mut CodeGen, dbg_info: bool) -> Result<(), String> {
-    node.compile(codegen, no_drop!(), dbg_info)
+/// Runs the [Optimize] pass, then calls [Compile::compile] with no
+/// context-driven elision at the top level.
+pub fn compile(
+    ast: &mut Ast,
+    node: NodeId,
+    codegen: &mut CodeGen,
+    dbg_info: bool,
+) -> Result<(), String> {
+    let node = ast.optimize(node);
+    node.compile(ast, codegen, no_drop!(), dbg_info)
 }
 
 /// The trait that defines a way to compile the object.
@@ -182,13 +324,19 @@ trait Compile {
     ///
     /// If `dbg_info` is true, a special statement will be inserted at the end
     /// of each evaluation to support `n` command in the debugger.
-    fn compile(&self, codegen: &mut CodeGen, ctx: ContexInfo, dbg_info: bool)
-    -> Result<(), String>;
+    fn compile(
+        &self,
+        ast: &mut Ast,
+        codegen: &mut CodeGen,
+        ctx: ContexInfo,
+        dbg_info: bool,
+    ) -> Result<(), String>;
 }
 
 impl Compile for Symbol {
     fn compile(
         &self,
+        _ast: &mut Ast,
         codegen: &mut CodeGen,
         ctx: ContexInfo,
         _dbg_info: bool,
@@ -196,10 +344,18 @@ impl Compile for Symbol {
         if !ctx.drop_ret {
             let code = match self {
                 Symbol::User(name) => {
-                    format!("rt_push(rt_get(\"{name}\"));")
+                    let name = atom_name(*name);
+                    match codegen.local_ref(name) {
+                        Some(code) => code,
+                        None => {
+                            let var = codegen.symbol_id(name);
+                            format!("rt_push(rt_get_id({var}));")
+                        }
+                    }
                 }
                 _ => {
-                    format!("rt_new_symbol(\"{self}\");")
+                    let var = codegen.symbol_id(&self.to_string());
+                    format!("rt_new_symbol_id({var});")
                 }
             };
             codegen.append_code(&code);
@@ -208,14 +364,15 @@ impl Compile for Symbol {
     }
 }
 
-impl Compile for Node {
+impl Compile for NodeId {
     fn compile(
         &self,
+        ast: &mut Ast,
         codegen: &mut CodeGen,
         ctx: ContexInfo,
         dbg_info: bool,
     ) -> Result<(), String> {
-        match self {
+        match ast.get(*self).clone() {
             Node::String(val) => {
                 if !ctx.drop_ret {
                     codegen.append_code(&format!("rt_new_symbol(\"{val}\");"))
@@ -234,7 +391,7 @@ impl Compile for Node {
                 }
                 Ok(())
             }
-            Node::Pair(car, cdr) => match &*car.borrow() {
+            Node::Pair(car, cdr) => match ast.get(car).clone() {
                 Node::Number(num) => Err(format!("{num} can not be the head of a list")),
                 Node::SpecialForm(form) => match form {
                     // This corresponds to the apply part of the interpreter.
@@ -242,27 +399,38 @@ impl Compile for Node {
                     // special forms must be applied at compile-time.
                     SpecialForm::Lambda => {
                         if !ctx.drop_ret {
-                            let (pattern, body) = cdr.borrow().as_pair()?;
+                            let (pattern, body) = ast.as_pair(cdr)?;
 
                             // Use `begin` to support multiple statements.
-                            let mut body =
-                                Node::Pair(Node::SpecialForm(SpecialForm::Begin).into(), body);
+                            let begin = ast.add(Node::SpecialForm(SpecialForm::Begin));
+                            let mut body = ast.pair(begin, body);
 
                             let lambda_id = inc();
 
                             // Replace operands with its index.
-                            let pattern = Pattern::try_from(pattern.clone())?;
+                            let pattern = ast.pattern(pattern)?;
                             let mut pvec = vec![];
                             pattern.vectorize(&mut pvec);
                             for (i, sym) in pvec.iter().enumerate() {
-                                body.replace(
-                                    &Node::Symbol(Symbol::User(sym.clone())),
-                                    &Node::Symbol(Symbol::User(format!("#{i}_func_{lambda_id}"))),
-                                );
+                                let src = ast.add(Node::Symbol(Symbol::User(intern(sym))));
+                                let dst = ast.add(Node::Symbol(Symbol::User(intern(&format!(
+                                    "#{i}_func_{lambda_id}"
+                                )))));
+                                body = ast.replace(body, src, dst);
                             }
 
                             // Generate function body.
                             let mut lambda_gen = CodeGen::new_internal(lambda_id);
+                            // Share the symbol and constant tables so the
+                            // closure reuses the statics already allocated by
+                            // the enclosing code.
+                            lambda_gen.symbols = codegen.symbols.clone();
+                            lambda_gen.constants = codegen.constants.clone();
+                            lambda_gen.dbg_texts = codegen.dbg_texts.clone();
+                            // The closure's body sees the enclosing lambdas
+                            // plus itself.
+                            lambda_gen.scope = codegen.scope.clone();
+                            lambda_gen.scope.push(lambda_id);
                             // The lambda body should not drop the return value,
                             // but it can drop the environment as it is just a
                             // copy of current environment and no one will use it.
@@ -271,12 +439,17 @@ impl Compile for Node {
                                 drop_env: true,
                                 drop_ret: false,
                             };
-                            body.compile(&mut lambda_gen, ctx, dbg_info)?;
+                            body.compile(ast, &mut lambda_gen, ctx, dbg_info)?;
                             codegen.merge(lambda_gen);
 
+                            // A body that creates no closure cannot capture
+                            // its call environment, so the runtime allocates
+                            // the frame on its frame stack instead of the GC
+                            // heap.
+                            let escapes = creates_closure(ast, body);
                             // Write the code that creates the closure.
                             codegen.append_code(&format!(
-                                "rt_new_closure(\"{lambda_id}\", func_{lambda_id}, {}, {});",
+                                "rt_new_closure(\"{lambda_id}\", func_{lambda_id}, {}, {}, {escapes});",
                                 pvec.len(),
                                 !pattern.is_proper_list()
                             ));
@@ -284,9 +457,10 @@ impl Compile for Node {
                         Ok(())
                     }
                     SpecialForm::Display => {
-                        let params = get_n_params(cdr.clone(), 1)?;
+                        let params = get_n_params(ast, cdr, 1)?;
                         // Keep the node to display.
-                        params[0].borrow().compile(
+                        params[0].compile(
+                            ast,
                             codegen,
                             ContexInfo {
                                 drop_env: ctx.drop_env,
@@ -303,40 +477,42 @@ fflush(NULL);"#,
                         Ok(())
                     }
                     SpecialForm::NewLine => {
-                        let _ = get_n_params(cdr.clone(), 0)?;
+                        let _ = get_n_params(ast, cdr, 0)?;
                         codegen.append_code("printf(\"\\n\");");
                         return_nil!(codegen, ctx);
                         Ok(())
                     }
                     SpecialForm::BreakPoint => {
-                        let _ = get_n_params(cdr.clone(), 0)?;
+                        let _ = get_n_params(ast, cdr, 0)?;
                         codegen.append_code("rt_breakpoint();");
                         return_nil!(codegen, ctx);
                         Ok(())
                     }
                     SpecialForm::Define => {
-                        let params = get_n_params(cdr.clone(), 2)?;
+                        let params = get_n_params(ast, cdr, 2)?;
                         if ctx.drop_env {
                             // The environment will be dropped anyway.
                             Ok(())
-                        } else if let Node::Symbol(Symbol::User(name)) = &*params[0].borrow() {
+                        } else if let Node::Symbol(Symbol::User(name)) = *ast.get(params[0]) {
                             // `define` uses both of the environment and the return value.
                             // So do `set*`.
-                            params[1].borrow().compile(codegen, no_drop!(), dbg_info)?;
-                            codegen.append_code(&format!("rt_define(\"{name}\", rt_pop());"));
+                            params[1].compile(ast, codegen, no_drop!(), dbg_info)?;
+                            let var = codegen.symbol_id(atom_name(name));
+                            codegen.append_code(&format!("rt_define_id({var}, rt_pop());"));
                             return_nil!(codegen, ctx);
                             Ok(())
                         } else {
                             Err(format!(
                                 "{} is not a user defined symbol",
-                                params[0].borrow()
+                                ast.display(params[0])
                             ))
                         }
                     }
                     SpecialForm::Set => {
                         set_family!(
-                            "set",
-                            |name| { format!("\"{name}\"") },
+                            "set_id",
+                            |var| { var },
+                            ast,
                             cdr,
                             codegen,
                             ctx,
@@ -346,7 +522,8 @@ fflush(NULL);"#,
                     SpecialForm::SetCar => {
                         set_family!(
                             "set_car",
-                            |name| { format!("rt_get(\"{name}\")") },
+                            |var| { format!("rt_get_id({var})") },
+                            ast,
                             cdr,
                             codegen,
                             ctx,
@@ -356,7 +533,8 @@ fflush(NULL);"#,
                     SpecialForm::SetCdr => {
                         set_family!(
                             "set_cdr",
-                            |name| { format!("rt_get(\"{name}\")") },
+                            |var| { format!("rt_get_id({var})") },
+                            ast,
                             cdr,
                             codegen,
                             ctx,
@@ -366,27 +544,25 @@ fflush(NULL);"#,
                     SpecialForm::If => {
                         // The value and environment of precondition must be preserved;
                         // those of the branches can be dropped.
-                        let params = get_n_params(cdr.clone(), 3)?;
-                        params[0].borrow().compile(codegen, no_drop!(), dbg_info)?;
+                        let params = get_n_params(ast, cdr, 3)?;
+                        params[0].compile(ast, codegen, no_drop!(), dbg_info)?;
                         codegen.append_code("if (rt_get_bool(rt_pop()) > 0) {");
-                        params[1].borrow().compile(codegen, ctx, dbg_info)?;
+                        params[1].compile(ast, codegen, ctx, dbg_info)?;
                         codegen.append_code("} else {");
-                        params[2].borrow().compile(codegen, ctx, dbg_info)?;
+                        params[2].compile(ast, codegen, ctx, dbg_info)?;
                         codegen.append_code("}");
                         Ok(())
                     }
                     SpecialForm::Quote => {
                         if !ctx.drop_ret {
-                            let params = get_n_params(cdr.clone(), 1)?;
-                            codegen.append_code(&format!(
-                                "rt_new_constant(\"{}\");",
-                                params[0].borrow()
-                            ));
+                            let params = get_n_params(ast, cdr, 1)?;
+                            let var = codegen.constant_id(&ast.display(params[0]).to_string());
+                            codegen.append_code(&format!("rt_push(rt_get_constant({var}));"));
                         }
                         Ok(())
                     }
                     SpecialForm::Begin => {
-                        let operands = vectorize(cdr.clone())?;
+                        let operands = vectorize(ast, cdr)?;
                         if !operands.is_empty() {
                             for (i, operand) in operands.iter().enumerate() {
                                 let is_last = i == operands.len() - 1;
@@ -399,14 +575,15 @@ fflush(NULL);"#,
                                         drop_ret: true,
                                     }
                                 };
-                                operand.borrow().compile(codegen, context, dbg_info)?;
+                                operand.compile(ast, codegen, context, dbg_info)?;
                             }
                         }
                         Ok(())
                     }
                     SpecialForm::Import => {
-                        let params = get_n_params(cdr.clone(), 1)?;
-                        codegen.append_code(&format!("rt_import(\"{}\");", params[0].borrow()));
+                        let params = get_n_params(ast, cdr, 1)?;
+                        codegen
+                            .append_code(&format!("rt_import(\"{}\");", ast.display(params[0])));
                         return_nil!(codegen, ctx);
                         Ok(())
                     }
@@ -415,15 +592,15 @@ fflush(NULL);"#,
                         Ok(())
                     }
                     SpecialForm::Apply => {
-                        let params = get_n_params(cdr.clone(), 2)?;
+                        let params = get_n_params(ast, cdr, 2)?;
                         // operand list
-                        params[1].borrow().compile(codegen, no_drop!(), dbg_info)?;
+                        params[1].compile(ast, codegen, no_drop!(), dbg_info)?;
 
                         // list -> stack
                         codegen.append_code("rt_list_to_stack();");
 
                         // operator
-                        params[0].borrow().compile(codegen, no_drop!(), dbg_info)?;
+                        params[0].compile(ast, codegen, no_drop!(), dbg_info)?;
 
                         call_procedure(ctx, codegen);
                         Ok(())
@@ -431,32 +608,51 @@ fflush(NULL);"#,
                     _ => unreachable!(),
                 },
                 _ => {
-                    let operands = vectorize(cdr.clone())?;
+                    let operands = vectorize(ast, cdr)?;
+
+                    // Applications of statically-known primitives are
+                    // open-coded. Builtins cannot be rebound (`define` and
+                    // `set!` only accept user symbols), so the nargs node,
+                    // the operator node and the dispatch in `rt_apply` can
+                    // all be skipped.
+                    let inlined = if let Node::Symbol(sym) = ast.get(car) {
+                        inline_primitive(sym, operands.len())
+                    } else {
+                        None
+                    };
 
                     // operands
                     for operand in operands.iter().rev() {
-                        operand.borrow().compile(codegen, no_drop!(), dbg_info)?;
+                        operand.compile(ast, codegen, no_drop!(), dbg_info)?;
                     }
 
-                    // nargs
-                    codegen.append_code(&format!("rt_new_integer({});", operands.len()));
+                    if let Some(call) = inlined {
+                        codegen.append_code(&call);
+                        // Drop the result if the caller wants to drop it.
+                        if ctx.drop_ret {
+                            codegen.append_code("rt_pop();");
+                        }
+                    } else {
+                        // nargs
+                        codegen.append_code(&format!("rt_new_integer({});", operands.len()));
 
-                    // operator
-                    car.borrow().compile(codegen, no_drop!(), dbg_info)?;
+                        // operator
+                        car.compile(ast, codegen, no_drop!(), dbg_info)?;
 
-                    call_procedure(ctx, codegen);
+                        call_procedure(ctx, codegen);
+                    }
                     Ok(())
                 }
             },
-            Node::SpecialForm(_) => unreachable!("{self}"),
-            Node::Symbol(sym) => sym.compile(codegen, ctx, dbg_info),
+            Node::SpecialForm(_) => unreachable!("{}", ast.display(*self)),
+            Node::Symbol(sym) => sym.compile(ast, codegen, ctx, dbg_info),
         }?;
         if dbg_info {
-            let self_str = self.to_string();
+            let self_str = ast.display(*self).to_string();
             let self_str = self_str.replace("\"", "'");
+            let var = codegen.dbg_info_id(&self_str);
             codegen.append_code(&format!(
-                "rt_evaluated(\"{}\", {});",
-                self_str,
+                "rt_evaluated_id({var}, {});",
                 if ctx.drop_ret { 1 } else { 0 }
             ));
         }
@@ -464,24 +660,46 @@ fflush(NULL);"#,
     }
 }
 
+/// The C call that implements an application of `sym` with `nargs` operands,
+/// for the primitives the compiler open-codes instead of dispatching through
+/// `rt_apply`.
+fn inline_primitive(sym: &Symbol, nargs: usize) -> Option<String> {
+    match (sym, nargs) {
+        (Symbol::Car, 1) => Some("rt_car();".to_string()),
+        (Symbol::Cdr, 1) => Some("rt_cdr();".to_string()),
+        (Symbol::Cons, 2) => Some("rt_cons();".to_string()),
+        (Symbol::Add, 2) => Some("rt_add2();".to_string()),
+        (Symbol::Sub, 2) => Some("rt_sub2();".to_string()),
+        (Symbol::Mul, 2) => Some("rt_mul2();".to_string()),
+        (Symbol::List, n) => Some(format!("rt_new_list({n});")),
+        _ => None,
+    }
+}
+
 fn call_procedure(ctx: ContexInfo, codegen: &mut CodeGen) {
     let call_closure = if ctx.drop_env {
+        // Tail position: drop the finished activation's frame, schedule the
+        // callee and fall out of the enclosing function; the driver loop of
+        // the nearest non-tail application bounces into it, so the C stack
+        // does not grow.
         r#"
-rt_add_root("__closure", rt_pop());
-rt_prepare_args(rt_get_root("__closure"));
-c_func func = rt_get_c_func(rt_remove_root("__closure"));
-func();
+rt_reg_set(RT_REG_CLOSURE, rt_pop());
+rt_drop_frame();
+rt_prepare_args(rt_reg_get(RT_REG_CLOSURE));
+rt_tail_call(rt_get_c_func(rt_reg_get(RT_REG_CLOSURE)));
 "#
     } else {
+        // The runtime's environment stack remembers the caller's
+        // environment and frame watermark, so the result stays on top of
+        // the value stack.
         r#"
-rt_add_root("__old_env", rt_current_env());
-rt_add_root("__closure", rt_pop());
-rt_prepare_args(rt_get_root("__closure"));
-rt_push(rt_remove_root("__old_env"));
-c_func func = rt_get_c_func(rt_remove_root("__closure"));
+rt_save_env();
+rt_reg_set(RT_REG_CLOSURE, rt_pop());
+rt_prepare_args(rt_reg_get(RT_REG_CLOSURE));
+c_func func = rt_get_c_func(rt_reg_get(RT_REG_CLOSURE));
 func();
-rt_swap();
-rt_move_to_env(rt_pop());
+while ((func = rt_next_call()) != NULL) func();
+rt_restore_env();
 "#
     };
 
@@ -7,6 +7,7 @@
 /// provide the correct components.
 pub trait Env<K, V, R>
 where
+    K: ?Sized,
     V: Clone,
 {
     /// Insert key-value pair into current environment.
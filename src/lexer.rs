@@ -142,7 +142,9 @@ pub enum TokenType {
 }
 
 pub struct Lexer {
-    raw: String,
+    // Characters rather than a string: token scanning indexes by position,
+    // which must stay O(1) for lexing to be linear in the input length.
+    raw: Vec<char>,
     cur_pos: usize,
 }
 
@@ -152,11 +154,18 @@ impl Lexer {
         T: ToString,
     {
         Lexer {
-            raw: s.to_string(),
+            raw: s.to_string().chars().collect(),
             cur_pos: 0,
         }
     }
 
+    /// Append more input to the end of the stream. Tokens already consumed
+    /// are unaffected; lexing resumes at the current position into the new
+    /// text.
+    pub fn append(&mut self, s: &str) {
+        self.raw.extend(s.chars());
+    }
+
     pub fn get_cur_pos(&self) -> usize {
         self.cur_pos
     }
@@ -197,7 +206,7 @@ impl Lexer {
     fn peek_symbol(&self, cur_pos: usize) -> Result<(usize, TokenType), ParseError> {
         let mut symbol = String::new();
         let mut cur_pos = cur_pos;
-        while let Some(x) = self.raw.chars().nth(cur_pos) {
+        while let Some(x) = self.raw.get(cur_pos).copied() {
             if self.is_special_char(x) {
                 break;
             }
@@ -217,7 +226,7 @@ impl Lexer {
             Float,
         }
         let mut state = State::Start;
-        while let Some(x) = self.raw.chars().nth(cur_pos) {
+        while let Some(x) = self.raw.get(cur_pos).copied() {
             match (x, &mut state) {
                 ('-', State::Start) => state = State::NegSym,
                 (x, State::Start) | (x, State::NegSym) | (x, State::Integer)
@@ -231,7 +240,7 @@ impl Lexer {
             };
             cur_pos += 1;
         }
-        let num_str = self.raw.as_str()[pos..cur_pos].to_string();
+        let num_str: String = self.raw[pos..cur_pos].iter().collect();
         match state {
             // A `-` that does not followed by a digit is parsed as `-` symbol.
             State::NegSym => Ok((cur_pos, TokenType::Symbol("-".to_string()))),
@@ -259,14 +268,14 @@ impl Lexer {
     pub fn peek_next_token(&mut self) -> Result<(usize, TokenType), ParseError> {
         let mut cur_pos = self.cur_pos;
         // remove whitespace
-        while let Some(x) = self.raw.chars().nth(cur_pos) {
+        while let Some(x) = self.raw.get(cur_pos).copied() {
             if self.is_whitespace(x) {
                 cur_pos += 1;
             } else {
                 break;
             }
         }
-        match self.raw.chars().nth(cur_pos) {
+        match self.raw.get(cur_pos).copied() {
             Some(ch) => match ch {
                 '(' => Ok((cur_pos + 1, TokenType::LParem)),
                 ')' => Ok((cur_pos + 1, TokenType::RParem)),
@@ -274,7 +283,7 @@ impl Lexer {
                 '.' => Ok((cur_pos + 1, TokenType::Dot)),
                 '\"' => {
                     let mut next_pos = cur_pos + 1;
-                    while let Some(x) = self.raw.chars().nth(next_pos) {
+                    while let Some(x) = self.raw.get(next_pos).copied() {
                         if x == '\"' {
                             break;
                         }
@@ -283,14 +292,14 @@ impl Lexer {
                     Ok((
                         next_pos + 1,
                         TokenType::String(
-                            self.raw.as_str()[cur_pos + 1..next_pos].into(),
+                            self.raw[cur_pos + 1..next_pos].iter().collect(),
                         ),
                     ))
                 }
                 // Comment starts with `;` and ends with `\n`.
                 ';' => {
                     let mut next_pos = cur_pos + 1;
-                    while let Some(x) = self.raw.chars().nth(next_pos) {
+                    while let Some(x) = self.raw.get(next_pos).copied() {
                         if x == '\n' {
                             break;
                         }
@@ -4,23 +4,26 @@ pub mod error;
 pub mod lexer;
 pub mod logger;
 pub mod node;
+pub mod optimize;
 pub mod package;
 pub mod parser;
 pub mod preprocess;
 pub mod runtime;
 pub mod symbol;
 mod util;
-use std::sync::{LazyLock, RwLock};
+use std::{
+    cell::{Cell, UnsafeCell},
+    sync::LazyLock,
+};
 
 use crate::{
     env::Env,
-    error::ParseError,
-    lexer::Number,
+    lexer::{Lexer, Number},
     logger::log_warning,
-    node::Node,
+    node::{Ast, NodeId},
     package::load_package,
-    runtime::{Closure, LoadToRuntime, Runtime, RuntimeNode, StackMachine},
-    symbol::Symbol,
+    runtime::{Closure, LoadToRuntime, Runtime, RuntimeNode, StackMachine, load_streaming},
+    symbol::{AtomId, Symbol},
     util::CVoidFunc,
 };
 
@@ -37,27 +40,239 @@ where
     }
 }
 
-pub fn run_node(node: Node) -> Result<String, String> {
-    node.jit_compile(false)?;
-    let mut runtime = RT.write().unwrap();
+pub fn run_node(ast: &mut Ast, node: NodeId) -> Result<String, String> {
+    ast.jit_compile(node, false)?;
+    let runtime = RT.write();
     let index = runtime.pop();
     Ok(runtime.display_node_idx(index))
 }
 
-/// The runtime that is pointed by all C bindings.
-pub static RT: LazyLock<RwLock<Runtime>> = LazyLock::new(|| RwLock::new(Runtime::new(1)));
+/// A thread-confined handle to one isolated [Runtime] context.
+///
+/// A context is used by one thread at a time: the thread that entered it
+/// (see [context_enter]) runs the compiled code, the REPL and the debugger
+/// callback, so no caller can observe a half-updated runtime and the
+/// accessors need no synchronization.
+pub struct RuntimeHandle {
+    inner: UnsafeCell<Runtime>,
+}
+
+// SAFETY: every access happens on the thread that entered the context
+// (see the struct documentation).
+unsafe impl Sync for RuntimeHandle {}
+
+impl RuntimeHandle {
+    fn new(runtime: Runtime) -> Self {
+        RuntimeHandle {
+            inner: UnsafeCell::new(runtime),
+        }
+    }
+
+    /// Get mutable access to the runtime.
+    #[allow(clippy::mut_from_ref)]
+    pub fn write(&self) -> &mut Runtime {
+        unsafe { &mut *self.inner.get() }
+    }
+
+    /// Get shared access to the runtime.
+    pub fn read(&self) -> &Runtime {
+        unsafe { &*self.inner.get() }
+    }
+}
+
+/// The process-wide default context, used by threads that never enter one
+/// explicitly — the original single-runtime behaviour.
+///
+/// The heap starts at one node slot unless `RELIC_HEAP_SIZE` says otherwise;
+/// `RELIC_HEAP_GROWTH` overrides the growth factor the same way. Programs
+/// that know their working set can also call `rt_start_with_heap` or
+/// `rt_reserve` instead of configuring the environment.
+static DEFAULT_CTX: LazyLock<RuntimeHandle> = LazyLock::new(|| {
+    let size = env_config("RELIC_HEAP_SIZE").unwrap_or(1);
+    RuntimeHandle::new(new_runtime(size))
+});
+
+thread_local! {
+    /// The context the calling thread's `rt_*` calls resolve to.
+    static CURRENT_CTX: Cell<Option<&'static RuntimeHandle>> = const { Cell::new(None) };
+}
+
+/// Build a runtime with `size` node slots (at least one), honouring the
+/// `RELIC_HEAP_GROWTH` override.
+fn new_runtime(size: usize) -> Runtime {
+    let mut runtime = Runtime::new(size.max(1));
+    if let Some(factor) = env_config("RELIC_HEAP_GROWTH") {
+        runtime.set_growth_factor(factor);
+    }
+    runtime
+}
+
+/// Create an isolated runtime context with its own stack, GC areas and
+/// roots. Contexts are leaked: an embedding server creates one per worker
+/// thread and keeps it for the life of the process. Loaded packages are
+/// plain shared libraries, so contexts share their read-only pages.
+pub fn context_new(heap_size: usize) -> &'static RuntimeHandle {
+    Box::leak(Box::new(RuntimeHandle::new(new_runtime(heap_size))))
+}
+
+/// Make `ctx` the context of the calling thread's `rt_*` calls. A context
+/// must only be entered by one thread at a time.
+pub fn context_enter(ctx: &'static RuntimeHandle) {
+    CURRENT_CTX.with(|cell| cell.set(Some(ctx)));
+}
+
+/// The calling thread's context, defaulting to the process-wide one.
+pub fn context_current() -> &'static RuntimeHandle {
+    CURRENT_CTX.with(|cell| match cell.get() {
+        Some(ctx) => ctx,
+        None => {
+            let ctx = &*DEFAULT_CTX;
+            cell.set(Some(ctx));
+            ctx
+        }
+    })
+}
+
+/// The runtime that is pointed by all C bindings: every access resolves to
+/// the calling thread's current context, so compiled code and the `rt_*`
+/// APIs need no handle threaded through them.
+pub struct CurrentRuntime;
+
+impl CurrentRuntime {
+    /// Get mutable access to the current context's runtime.
+    pub fn write(&self) -> &mut Runtime {
+        context_current().write()
+    }
+
+    /// Get shared access to the current context's runtime.
+    pub fn read(&self) -> &Runtime {
+        context_current().read()
+    }
+}
+
+/// See [CurrentRuntime].
+pub static RT: CurrentRuntime = CurrentRuntime;
+
+/// Read a numeric configuration value from the environment, warning on
+/// unparsable input rather than failing startup.
+fn env_config(name: &str) -> Option<usize> {
+    let value = std::env::var(name).ok()?;
+    match value.parse() {
+        Ok(value) => Some(value),
+        Err(_) => {
+            log_warning(format!("ignoring {name}={value}: not a number"));
+            None
+        }
+    }
+}
+
+/// The per-entry-point call counters, in registration order.
+///
+/// Each `rt_*` function owns a function-local atomic (see [profile_api!])
+/// that registers itself here on its first hit, so [profile_report] only
+/// walks counters that have actually fired.
+static API_COUNTERS: std::sync::Mutex<Vec<(&'static str, &'static std::sync::atomic::AtomicUsize)>> =
+    std::sync::Mutex::new(Vec::new());
+
+/// Count one call to the named `rt_*` entry point.
+///
+/// Expands to a single relaxed increment of a function-local static, so
+/// unlike [Runtime::api_called] this stays on in production builds. The
+/// registration branch is a [std::sync::Once] fast path after the first
+/// call.
+macro_rules! profile_api {
+    ($name:literal) => {{
+        static CALLS: std::sync::atomic::AtomicUsize = std::sync::atomic::AtomicUsize::new(0);
+        static REGISTER: std::sync::Once = std::sync::Once::new();
+        REGISTER.call_once(|| API_COUNTERS.lock().unwrap().push(($name, &CALLS)));
+        CALLS.fetch_add(1, std::sync::atomic::Ordering::Relaxed);
+    }};
+}
+
+/// Format the profiling counters: closure invocations from the runtime
+/// followed by the `rt_*` entry-point counts, hottest first. Closures are
+/// listed as `func_{id}`, matching their names in the generated C.
+pub fn profile_report(runtime: &Runtime) -> String {
+    let mut out = String::from("closure calls:\n");
+    for (id, calls) in runtime.closure_hot_list() {
+        out.push_str(&format!("\tfunc_{id}: {calls}\n"));
+    }
+    out.push_str("api calls:\n");
+    let mut counters: Vec<(&str, usize)> = API_COUNTERS
+        .lock()
+        .unwrap()
+        .iter()
+        .map(|(name, calls)| (*name, calls.load(std::sync::atomic::Ordering::Relaxed)))
+        .collect();
+    counters.sort_by(|a, b| b.1.cmp(&a.1).then(a.0.cmp(b.0)));
+    for (name, calls) in counters {
+        out.push_str(&format!("\t{name}: {calls}\n"));
+    }
+    out
+}
+
+/// Calls [context_new]; the returned handle is opaque to C.
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_context_new(heap_size: usize) -> *mut std::ffi::c_void {
+    profile_api!("rt_context_new");
+    context_new(heap_size) as *const RuntimeHandle as *mut std::ffi::c_void
+}
+
+/// Calls [context_enter] with a handle from [rt_context_new].
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_context_enter(ctx: *mut std::ffi::c_void) {
+    profile_api!("rt_context_enter");
+    context_enter(unsafe { &*(ctx as *const RuntimeHandle) });
+}
+
+/// Calls [context_current].
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_context_current() -> *mut std::ffi::c_void {
+    profile_api!("rt_context_current");
+    context_current() as *const RuntimeHandle as *mut std::ffi::c_void
+}
+
+/// Formats the profiling counters; see [profile_report].
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_dump_profile() -> *mut i8 {
+    profile_api!("rt_dump_profile");
+    let rt = RT.read();
+    let c_str = std::ffi::CString::new(profile_report(rt)).unwrap();
+    c_str.into_raw()
+}
 
 /// Calls [Runtime::top_env].
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_start() {
-    let mut rt = RT.write().unwrap();
+    profile_api!("rt_start");
+    let rt = RT.write();
+    rt.top_env();
+}
+
+/// Like [rt_start], but grows the heap to at least `size` node slots first,
+/// so a program with a known working set skips the ramp-up collections.
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_start_with_heap(size: usize) {
+    profile_api!("rt_start_with_heap");
+    let rt = RT.write();
+    rt.reserve(size);
     rt.top_env();
 }
 
+/// Calls [Runtime::reserve].
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_reserve(size: usize) {
+    profile_api!("rt_reserve");
+    let rt = RT.write();
+    rt.api_called(|| format!("rt_reserve({size})"));
+    rt.reserve(size);
+}
+
 /// Calls [Runtime::add_root].
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_add_root(name: *const u8, value: usize) -> usize {
-    let mut rt = RT.write().unwrap();
+    profile_api!("rt_add_root");
+    let rt = RT.write();
     let c_str = unsafe { std::ffi::CStr::from_ptr(name as *const i8) };
     if let Ok(name_str) = c_str.to_str() {
         rt.add_root(name_str.to_string(), value);
@@ -71,7 +286,8 @@ pub extern "C" fn rt_add_root(name: *const u8, value: usize) -> usize {
 /// Calls [Runtime::set_root].
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_set_root(name: *const u8, value: usize) -> usize {
-    let mut rt = RT.write().unwrap();
+    profile_api!("rt_set_root");
+    let rt = RT.write();
     let c_str = unsafe { std::ffi::CStr::from_ptr(name as *const i8) };
     if let Ok(name_str) = c_str.to_str() {
         rt.set_root(name_str.to_string(), value);
@@ -85,12 +301,13 @@ pub extern "C" fn rt_set_root(name: *const u8, value: usize) -> usize {
 /// Calls [Runtime::get_root].
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_get_root(name: *const u8) -> usize {
+    profile_api!("rt_get_root");
     let c_str = unsafe { std::ffi::CStr::from_ptr(name as *const i8) };
     if let Ok(name_str) = c_str.to_str() {
-        let rt = RT.read().unwrap();
+        let rt = RT.read();
         rt.get_root(name_str)
     } else {
-        let mut rt = RT.write().unwrap();
+        let rt = RT.write();
         rt.error("Error in rt_get_root: invalid string");
         0
     }
@@ -99,7 +316,8 @@ pub extern "C" fn rt_get_root(name: *const u8) -> usize {
 /// Calls [Runtime::remove_root].
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_remove_root(name: *const u8) -> usize {
-    let mut rt = RT.write().unwrap();
+    profile_api!("rt_remove_root");
+    let rt = RT.write();
     let c_str = unsafe { std::ffi::CStr::from_ptr(name as *const i8) };
     if let Ok(name_str) = c_str.to_str() {
         rt.remove_root(name_str)
@@ -109,18 +327,42 @@ pub extern "C" fn rt_remove_root(name: *const u8) -> usize {
     }
 }
 
+/// Calls [Runtime::reg_set].
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_reg_set(reg: usize, value: usize) {
+    profile_api!("rt_reg_set");
+    let rt = RT.write();
+    rt.api_called(|| format!("rt_reg_set({reg}, {value})"));
+    rt.reg_set(reg, value);
+}
+
+/// Calls [Runtime::reg_get].
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_reg_get(reg: usize) -> usize {
+    profile_api!("rt_reg_get");
+    let rt = RT.read();
+    rt.reg_get(reg)
+}
+
 /// Calls [Closure::new] and pushes the result to the stack.
 #[unsafe(no_mangle)]
-pub extern "C" fn rt_new_closure(name: *const u8, func: CVoidFunc, nargs: usize, variadic: bool) {
+pub extern "C" fn rt_new_closure(
+    name: *const u8,
+    func: CVoidFunc,
+    nargs: usize,
+    variadic: bool,
+    escapes: bool,
+) {
+    profile_api!("rt_new_closure");
     let c_str = unsafe { std::ffi::CStr::from_ptr(name as *const i8) };
-    let mut rt = RT.write().unwrap();
+    let mut rt = RT.write();
     if let Ok(name) = c_str.to_str() {
-        rt.api_called(format!(
-            "rt_new_closure({name}, <func>, {nargs}, {variadic})"
+        rt.api_called(|| format!(
+            "rt_new_closure({name}, <func>, {nargs}, {variadic}, {escapes})"
         ));
         rt.try_gc();
 
-        let val = Closure::new(name.to_string(), func, nargs, variadic, &rt);
+        let val = Closure::new(name.to_string(), func, nargs, variadic, escapes, &rt);
         val.load_to(&mut rt).unwrap();
     } else {
         rt.error("Error in rt_remove_root: invalid string");
@@ -130,74 +372,108 @@ pub extern "C" fn rt_new_closure(name: *const u8, func: CVoidFunc, nargs: usize,
 /// Calls [Runtime::get_c_func].
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_get_c_func(cid: usize) -> Option<CVoidFunc> {
-    let mut runtime = RT.write().unwrap();
-    runtime.api_called(format!("rt_get_c_func({cid})"));
+    profile_api!("rt_get_c_func");
+    let mut runtime = RT.write();
+    runtime.api_called(|| format!("rt_get_c_func({cid})"));
     unwrap_result(runtime.get_c_func(cid), &mut runtime)
 }
 
+/// Calls [Runtime::tail_call]. Emitted for applications in tail position.
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_tail_call(func: CVoidFunc) {
+    profile_api!("rt_tail_call");
+    let rt = RT.write();
+    rt.api_called(|| "rt_tail_call(<func>)");
+    rt.tail_call(func);
+}
+
+/// Calls [Runtime::next_call]. Emitted in the driver loop of non-tail
+/// applications, which bounces until no tail call is pending.
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_next_call() -> Option<CVoidFunc> {
+    profile_api!("rt_next_call");
+    RT.write().next_call()
+}
+
 /// Calls [Runtime::list_to_stack].
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_list_to_stack() {
-    let mut runtime = RT.write().unwrap();
-    runtime.api_called("rt_list_to_stack()");
+    profile_api!("rt_list_to_stack");
+    let mut runtime = RT.write();
+    runtime.api_called(|| "rt_list_to_stack()");
     unwrap_result(runtime.list_to_stack(), &mut runtime);
 }
 
 /// Calls [Runtime::prepare_args].
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_prepare_args(cid: usize) {
-    let mut runtime = RT.write().unwrap();
-    runtime.api_called(format!("rt_prepare_args({cid})"));
+    profile_api!("rt_prepare_args");
+    let mut runtime = RT.write();
+    runtime.api_called(|| format!("rt_prepare_args({cid})"));
     unwrap_result(runtime.prepare_args(cid), &mut runtime);
 }
 
 /// Calls [Runtime::push].
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_push(index: usize) {
-    let mut rt = RT.write().unwrap();
-    rt.api_called(format!("rt_push({index})"));
+    profile_api!("rt_push");
+    let rt = RT.write();
+    rt.api_called(|| format!("rt_push({index})"));
     rt.push(index);
 }
 
 /// Calls [Runtime::pop].
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_pop() -> usize {
-    let mut rt = RT.write().unwrap();
-    rt.api_called("rt_pop()");
+    profile_api!("rt_pop");
+    let rt = RT.write();
+    rt.api_called(|| "rt_pop()");
     rt.pop()
 }
 
 /// Calls [Runtime::swap].
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_swap() {
-    let mut rt = RT.write().unwrap();
-    rt.api_called("rt_swap()");
+    profile_api!("rt_swap");
+    let rt = RT.write();
+    rt.api_called(|| "rt_swap()");
     rt.swap()
 }
 
 /// Calls [Runtime::top].
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_top() -> usize {
-    let mut rt = RT.write().unwrap();
-    rt.api_called("rt_top()");
+    profile_api!("rt_top");
+    let rt = RT.write();
+    rt.api_called(|| "rt_top()");
     rt.top()
 }
 
-/// Calls [Runtime::display_node_idx].
+/// Calls [Runtime::display_node_buf]. The returned string lives in a
+/// buffer the runtime reuses on the next call; the caller must not free it.
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_display_node_idx(index: usize) -> *const i8 {
+    profile_api!("rt_display_node_idx");
+    let rt = RT.write();
+    rt.api_called(|| format!("rt_display_node_idx({index})"));
+    rt.display_node_buf(index)
+}
+
+/// Formats the collector statistics; see [runtime::GcStats].
 #[unsafe(no_mangle)]
-pub extern "C" fn rt_display_node_idx(index: usize) -> *mut i8 {
-    let mut rt = RT.write().unwrap();
-    rt.api_called(format!("rt_display_node_idx({index})"));
-    let result = rt.display_node_idx(index);
-    let c_str = std::ffi::CString::new(result).unwrap();
+pub extern "C" fn rt_gc_stats() -> *mut i8 {
+    profile_api!("rt_gc_stats");
+    let rt = RT.read();
+    let c_str = std::ffi::CString::new(rt.gc_stats().to_string()).unwrap();
     c_str.into_raw()
 }
 
 /// Calls [Runtime::apply].
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_apply() -> usize {
-    let mut rt = RT.write().unwrap();
-    rt.api_called("rt_apply()".to_string());
+    profile_api!("rt_apply");
+    let rt = RT.write();
+    rt.api_called(|| "rt_apply()");
     match rt.apply() {
         Ok(()) => 1,
         Err(e) => {
@@ -207,50 +483,185 @@ pub extern "C" fn rt_apply() -> usize {
     }
 }
 
+/// Calls [Runtime::car]. Emitted for statically-known `(car ...)`.
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_car() {
+    profile_api!("rt_car");
+    let rt = RT.write();
+    rt.api_called(|| "rt_car()");
+    unwrap_result(rt.car(), rt);
+}
+
+/// Calls [Runtime::cdr]. Emitted for statically-known `(cdr ...)`.
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_cdr() {
+    profile_api!("rt_cdr");
+    let rt = RT.write();
+    rt.api_called(|| "rt_cdr()");
+    unwrap_result(rt.cdr(), rt);
+}
+
+/// Calls [Runtime::new_pair]. Emitted for statically-known `(cons ...)`.
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_cons() {
+    profile_api!("rt_cons");
+    let rt = RT.write();
+    rt.api_called(|| "rt_cons()");
+    rt.new_pair();
+}
+
+/// Calls [Runtime::new_list]. Emitted for statically-known `(list ...)`.
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_new_list(n: usize) {
+    profile_api!("rt_new_list");
+    let rt = RT.write();
+    rt.api_called(|| format!("rt_new_list({n})"));
+    rt.new_list(n);
+}
+
+/// Calls [Runtime::arith2]. Emitted for statically-known two-argument `(+ ...)`.
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_add2() {
+    profile_api!("rt_add2");
+    let rt = RT.write();
+    rt.api_called(|| "rt_add2()");
+    unwrap_result(rt.arith2(|a, b| a + b), rt);
+}
+
+/// Calls [Runtime::arith2]. Emitted for statically-known two-argument `(- ...)`.
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_sub2() {
+    profile_api!("rt_sub2");
+    let rt = RT.write();
+    rt.api_called(|| "rt_sub2()");
+    unwrap_result(rt.arith2(|a, b| a - b), rt);
+}
+
+/// Calls [Runtime::arith2]. Emitted for statically-known two-argument `(* ...)`.
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_mul2() {
+    profile_api!("rt_mul2");
+    let rt = RT.write();
+    rt.api_called(|| "rt_mul2()");
+    unwrap_result(rt.arith2(|a, b| a * b), rt);
+}
+
 /// The `(read)` special form.
+///
+/// Input is consumed in a single pass: when the expression spans several
+/// lines, the next line is appended to the lexer and parsing resumes where
+/// it stopped instead of re-parsing the accumulated text.
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_read() {
-    let mut rt = RT.write().unwrap();
-    rt.api_called("rt_read()");
-    let mut input = String::new();
-    loop {
-        let mut current = String::new();
-        std::io::stdin().read_line(&mut current).unwrap();
-        input.push_str(&current);
-        match input.load_to(&mut rt) {
-            Ok(()) => break,
-            Err(ParseError::EOF) => {
-                continue;
-            }
-            Err(e) => {
-                rt.error(&format!("Error in rt_read: {e}"));
-                RuntimeNode::Symbol(Symbol::Nil).load_to(&mut rt).unwrap();
-                break;
-            }
+    profile_api!("rt_read");
+    let mut rt = RT.write();
+    rt.api_called(|| "rt_read()");
+    let mut lexer = Lexer::new("");
+    let result = load_streaming(&mut lexer, &mut rt, &mut || {
+        let mut line = String::new();
+        match std::io::stdin().read_line(&mut line) {
+            Ok(0) | Err(_) => None,
+            Ok(_) => Some(line),
         }
+    });
+    if let Err(e) = result {
+        rt.error(&format!("Error in rt_read: {e}"));
+        RuntimeNode::Symbol(Symbol::Nil).load_to(&mut rt).unwrap();
     }
 }
 
 /// Parse an expression from a string and push the result to the stack
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_new_constant(expr: *const u8) {
-    let mut rt = RT.write().unwrap();
+    profile_api!("rt_new_constant");
+    let mut rt = RT.write();
     let c_str = unsafe { std::ffi::CStr::from_ptr(expr as *const i8) };
     if let Ok(expr_str) = c_str.to_str() {
-        rt.api_called(format!("rt_new_constant({expr_str})"));
+        rt.api_called(|| format!("rt_new_constant({expr_str})"));
         unwrap_result(expr_str.load_to(&mut rt), &mut rt);
     } else {
         rt.error("Error in rt_new_constant: invalid string");
     }
 }
 
+/// Parse an expression from a string into the calling context's constant
+/// pool and return its handle. The pool entries are GC roots, so compiled
+/// units can evaluate a quoted literal with [rt_get_constant] instead of
+/// re-parsing the string.
+///
+/// `handle` is the value the pooling site last got back, or `(size_t)-1`
+/// on its first run anywhere: the site allocates its process-wide handle
+/// once and keeps it in a per-module static. Re-pooling is idempotent per
+/// context — a context that has parsed its copy gets the handle straight
+/// back, while one that has not (the module's statics are shared between
+/// every context loading it) parses its own copy first.
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_pool_constant(handle: usize, expr: *const u8) -> usize {
+    profile_api!("rt_pool_constant");
+    let mut rt = RT.write();
+    let c_str = unsafe { std::ffi::CStr::from_ptr(expr as *const i8) };
+    if let Ok(expr_str) = c_str.to_str() {
+        rt.api_called(|| format!("rt_pool_constant({expr_str})"));
+        if handle != usize::MAX && rt.has_constant(handle) {
+            return handle;
+        }
+        let handle = if handle == usize::MAX {
+            runtime::alloc_constant_handle()
+        } else {
+            handle
+        };
+        unwrap_result(expr_str.load_to(&mut rt), &mut rt);
+        rt.set_constant(handle);
+        handle
+    } else {
+        rt.error("Error in rt_pool_constant: invalid string");
+        0
+    }
+}
+
+/// Calls [Runtime::get_constant].
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_get_constant(handle: usize) -> usize {
+    profile_api!("rt_get_constant");
+    let rt = RT.read();
+    rt.get_constant(handle)
+}
+
+/// Calls [symbol::intern].
+///
+/// Compiled units call this once at startup for every symbol they mention
+/// and refer to the symbol by the returned id afterwards, so the name is
+/// converted from C only once.
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_intern(name: *const u8) -> usize {
+    profile_api!("rt_intern");
+    let c_str = unsafe { std::ffi::CStr::from_ptr(name as *const i8) };
+    if let Ok(name_str) = c_str.to_str() {
+        symbol::intern(name_str) as usize
+    } else {
+        RT.write().error("Error in rt_intern: invalid string");
+        0
+    }
+}
+
+/// Create a new symbol from an interned id and push the result to the stack
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_new_symbol_id(id: usize) {
+    profile_api!("rt_new_symbol_id");
+    let mut rt = RT.write();
+    let name = symbol::atom_name(id as AtomId);
+    rt.api_called(|| format!("rt_new_symbol_id({name})"));
+    unwrap_result(Symbol::from(name).load_to(&mut rt), &mut rt);
+}
+
 /// Create a new symbol and push the result to the stack
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_new_symbol(name: *const u8) {
-    let mut rt = RT.write().unwrap();
+    profile_api!("rt_new_symbol");
+    let mut rt = RT.write();
     let c_str = unsafe { std::ffi::CStr::from_ptr(name as *const i8) };
     if let Ok(name_str) = c_str.to_str() {
-        rt.api_called(format!("rt_new_symbol({name_str})"));
+        rt.api_called(|| format!("rt_new_symbol({name_str})"));
         unwrap_result(Symbol::from(name_str).load_to(&mut rt), &mut rt);
     } else {
         rt.error("Error in rt_new_symbol: invalid string");
@@ -260,81 +671,108 @@ pub extern "C" fn rt_new_symbol(name: *const u8) {
 /// Create a new number and push the result to the stack
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_new_integer(value: i64) {
-    let mut rt = RT.write().unwrap();
-    rt.api_called(format!("rt_new_integer({value})"));
+    profile_api!("rt_new_integer");
+    let mut rt = RT.write();
+    rt.api_called(|| format!("rt_new_integer({value})"));
     Number::Int(value).load_to(&mut rt).unwrap()
 }
 
 /// Create a new float and push the result to the stack
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_new_float(value: f64) {
-    let mut rt = RT.write().unwrap();
-    rt.api_called(format!("rt_new_float({value})"));
+    profile_api!("rt_new_float");
+    let mut rt = RT.write();
+    rt.api_called(|| format!("rt_new_float({value})"));
     Number::Float(value).load_to(&mut rt).unwrap()
 }
 
 /// Calls [Runtime::current_env].
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_current_env() -> usize {
-    let mut rt = RT.write().unwrap();
-    rt.api_called("rt_current_env()");
+    profile_api!("rt_current_env");
+    let rt = RT.write();
+    rt.api_called(|| "rt_current_env()");
     rt.current_env()
 }
 
 /// Calls [Runtime::move_to_env].
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_move_to_env(env: usize) {
-    let mut rt = RT.write().unwrap();
-    rt.api_called(format!("rt_move_to_env({env})"));
+    profile_api!("rt_move_to_env");
+    let rt = RT.write();
+    rt.api_called(|| format!("rt_move_to_env({env})"));
     rt.move_to_env(env);
 }
 
+/// Calls [Runtime::save_env]. Emitted before a non-tail application.
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_save_env() {
+    profile_api!("rt_save_env");
+    let rt = RT.write();
+    rt.api_called(|| "rt_save_env()");
+    rt.save_env();
+}
+
+/// Calls [Runtime::restore_env]. Emitted after a non-tail application.
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_restore_env() {
+    profile_api!("rt_restore_env");
+    let rt = RT.write();
+    rt.api_called(|| "rt_restore_env()");
+    rt.restore_env();
+}
+
+/// Calls [Runtime::drop_frame]. Emitted before a tail application.
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_drop_frame() {
+    profile_api!("rt_drop_frame");
+    let rt = RT.write();
+    rt.api_called(|| "rt_drop_frame()");
+    rt.drop_frame();
+}
+
 /// Calls [Env::define].
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_define(key: *const u8, value: usize) {
+    profile_api!("rt_define");
     let c_str = unsafe { std::ffi::CStr::from_ptr(key as *const i8) };
     let mut env = rt_current_env();
     if let Ok(key_str) = c_str.to_str() {
         RT.write()
-            .unwrap()
-            .api_called(format!("rt_define({key_str}, {value})"));
-        env.define(&key_str.to_string(), value, &mut RT.write().unwrap());
+            .api_called(|| format!("rt_define({key_str}, {value})"));
+        env.define(key_str, value, RT.write());
     } else {
         RT.write()
-            .unwrap()
             .error("Error in rt_define: invalid string");
     }
 }
 /// Calls [Env::set].
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_set(key: *const u8, value: usize) {
+    profile_api!("rt_set");
     let c_str = unsafe { std::ffi::CStr::from_ptr(key as *const i8) };
     let mut env = rt_current_env();
     if let Ok(key_str) = c_str.to_str() {
         RT.write()
-            .unwrap()
-            .api_called(format!("rt_set({key_str}, {value})"));
-        if env
-            .set(&key_str.to_string(), value, &mut RT.write().unwrap())
-            .is_none()
-        {
+            .api_called(|| format!("rt_set({key_str}, {value})"));
+        if env.set(key_str, value, RT.write()).is_none() {
             RT.write()
-                .unwrap()
-                .error(&format!("Error in rt_set: variable {key_str} not found"));
+            .error(&format!("Error in rt_set: variable {key_str} not found"));
         }
     } else {
-        RT.write().unwrap().error("Error in rt_set: invalid string");
+        RT.write().error("Error in rt_set: invalid string");
     }
 }
 /// Calls [Env::get].
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_get(key: *const u8) -> usize {
+    profile_api!("rt_get");
     let c_str = unsafe { std::ffi::CStr::from_ptr(key as *const i8) };
     let env = rt_current_env();
     if let Ok(key_str) = c_str.to_str() {
-        RT.write().unwrap().api_called(format!("rt_get({key_str})"));
-        let mut runtime = RT.write().unwrap();
-        match env.get(&key_str.to_string(), &runtime) {
+        RT.write().api_called(|| format!("rt_get({key_str})"));
+        let runtime = RT.write();
+        match env.get(key_str, &runtime) {
             Some(val) => val,
             None => {
                 log_warning(format!(
@@ -344,16 +782,78 @@ pub extern "C" fn rt_get(key: *const u8) -> usize {
             }
         }
     } else {
-        RT.write().unwrap().error("Error in rt_get: invalid string");
+        RT.write().error("Error in rt_get: invalid string");
         0
     }
 }
 
+/// Calls [Env::define] with an interned symbol id as the key.
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_define_id(id: usize, value: usize) {
+    profile_api!("rt_define_id");
+    let mut env = rt_current_env();
+    let key = symbol::atom_name(id as AtomId);
+    RT.write().api_called(|| format!("rt_define_id({key}, {value})"));
+    // Top-level defines go straight into the flat global table; the string
+    // key is never touched.
+    let runtime = RT.write();
+    if runtime.is_top_env(env) {
+        runtime.global_set(id as AtomId, value);
+        return;
+    }
+    env.define(key, value, RT.write());
+}
+/// Calls [Env::set] with an interned symbol id as the key.
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_set_id(id: usize, value: usize) {
+    profile_api!("rt_set_id");
+    let mut env = rt_current_env();
+    let key = symbol::atom_name(id as AtomId);
+    RT.write().api_called(|| format!("rt_set_id({key}, {value})"));
+    if env.set(key, value, RT.write()).is_none() {
+        RT.write()
+            .error(&format!("Error in rt_set_id: variable {key} not found"));
+    }
+}
+/// Calls [Runtime::get_local].
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_get_local(depth: usize, slot: usize) -> usize {
+    profile_api!("rt_get_local");
+    let mut rt = RT.write();
+    rt.api_called(|| format!("rt_get_local({depth}, {slot})"));
+    unwrap_result(rt.get_local(depth, slot), &mut rt)
+}
+/// Calls [Env::get] with an interned symbol id as the key.
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_get_id(id: usize) -> usize {
+    profile_api!("rt_get_id");
+    let env = rt_current_env();
+    let key = symbol::atom_name(id as AtomId);
+    RT.write().api_called(|| format!("rt_get_id({key})"));
+    let runtime = RT.write();
+    // At top level the lookup is a single array access in the global table.
+    let found = if runtime.is_top_env(env) {
+        runtime.global_get(id as AtomId)
+    } else {
+        env.get(key, &runtime)
+    };
+    match found {
+        Some(val) => val,
+        None => {
+            log_warning(format!(
+                "Error in rt_get_id: variable {key} not found, returning nil"
+            ));
+            runtime.new_node_with_gc(RuntimeNode::Symbol(Symbol::Nil))
+        }
+    }
+}
+
 /// Calls [Runtime::set_car].
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_set_car(index: usize, target: usize) -> usize {
-    let mut rt = RT.write().unwrap();
-    rt.api_called(format!("rt_set_car({index}, {target})"));
+    profile_api!("rt_set_car");
+    let rt = RT.write();
+    rt.api_called(|| format!("rt_set_car({index}, {target})"));
     match rt.set_car(true, index, target) {
         Ok(()) => index,
         Err(e) => {
@@ -366,8 +866,9 @@ pub extern "C" fn rt_set_car(index: usize, target: usize) -> usize {
 /// Calls [Runtime::set_cdr].
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_set_cdr(index: usize, target: usize) -> usize {
-    let mut rt = RT.write().unwrap();
-    rt.api_called(format!("rt_set_cdr({index}, {target})"));
+    profile_api!("rt_set_cdr");
+    let rt = RT.write();
+    rt.api_called(|| format!("rt_set_cdr({index}, {target})"));
     match rt.set_cdr(true, index, target) {
         Ok(()) => index,
         Err(e) => {
@@ -380,8 +881,9 @@ pub extern "C" fn rt_set_cdr(index: usize, target: usize) -> usize {
 /// Get the integer value
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_get_integer(index: usize) -> i64 {
-    let mut rt = RT.write().unwrap();
-    rt.api_called(format!("rt_get_integer({index})"));
+    profile_api!("rt_get_integer");
+    let rt = RT.write();
+    rt.api_called(|| format!("rt_get_integer({index})"));
     match rt.get_number(index) {
         Ok(Number::Int(val)) => val,
         Ok(_) => {
@@ -398,8 +900,9 @@ pub extern "C" fn rt_get_integer(index: usize) -> i64 {
 /// Get the float value
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_get_float(index: usize) -> f64 {
-    let mut rt = RT.write().unwrap();
-    rt.api_called(format!("rt_get_float({index})"));
+    profile_api!("rt_get_float");
+    let rt = RT.write();
+    rt.api_called(|| format!("rt_get_float({index})"));
     match rt.get_number(index) {
         Ok(Number::Float(val)) => val,
         Ok(_) => {
@@ -416,8 +919,9 @@ pub extern "C" fn rt_get_float(index: usize) -> f64 {
 /// Get the symbol value
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_get_symbol(index: usize) -> *mut i8 {
-    let mut rt = RT.write().unwrap();
-    rt.api_called(format!("rt_get_symbol({index})"));
+    profile_api!("rt_get_symbol");
+    let rt = RT.write();
+    rt.api_called(|| format!("rt_get_symbol({index})"));
     match rt.get_symbol(index) {
         Ok(sym) => {
             let bytes = format!("{sym}").into_bytes();
@@ -435,8 +939,9 @@ pub extern "C" fn rt_get_symbol(index: usize) -> *mut i8 {
 /// Returns 1 if the symbol is not nil, 0 if it is nil.
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_get_bool(index: usize) -> i32 {
-    let mut rt = RT.write().unwrap();
-    rt.api_called(format!("rt_get_bool({index})"));
+    profile_api!("rt_get_bool");
+    let rt = RT.write();
+    rt.api_called(|| format!("rt_get_bool({index})"));
     if let Ok(Symbol::Nil) = rt.get_symbol(index) {
         0
     } else {
@@ -449,44 +954,112 @@ pub extern "C" fn rt_get_bool(index: usize) -> i32 {
 /// Returns 1 if the node is a symbol, 0 otherwise.
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_is_symbol(index: usize) -> i32 {
-    let mut rt = RT.write().unwrap();
-    rt.api_called(format!("rt_is_symbol({index})"));
+    profile_api!("rt_is_symbol");
+    let rt = RT.write();
+    rt.api_called(|| format!("rt_is_symbol({index})"));
     if rt.get_symbol(index).is_ok() { 1 } else { 0 }
 }
 
 /// Import a package.
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_import(name: *const u8) {
+    profile_api!("rt_import");
     let c_str = unsafe { std::ffi::CStr::from_ptr(name as *const i8) };
     if let Ok(name_str) = c_str.to_str() {
         RT.write()
-            .unwrap()
-            .api_called(format!("rt_import({name_str})"));
-        if RT.read().unwrap().has_package(name_str) {
+            .api_called(|| format!("rt_import({name_str})"));
+        if RT.read().has_package(name_str) {
             return;
         }
-        unwrap_result(load_package(name_str), &mut RT.write().unwrap());
+        unwrap_result(load_package(name_str), RT.write());
     } else {
         RT.write()
-            .unwrap()
             .error("Error in rt_import: invalid string");
     }
 }
 
+/// Write a heap image of the warmed runtime to `path`; see
+/// [package::save_image].
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_save_image(path: *const u8) {
+    profile_api!("rt_save_image");
+    let c_str = unsafe { std::ffi::CStr::from_ptr(path as *const i8) };
+    if let Ok(path_str) = c_str.to_str() {
+        RT.write()
+            .api_called(|| format!("rt_save_image({path_str})"));
+        unwrap_result(package::save_image(path_str), RT.write());
+    } else {
+        RT.write()
+            .error("Error in rt_save_image: invalid string");
+    }
+}
+
+/// Restore a heap image written by [rt_save_image] on a freshly started
+/// runtime; see [package::restore_image].
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_restore_image(path: *const u8) {
+    profile_api!("rt_restore_image");
+    let c_str = unsafe { std::ffi::CStr::from_ptr(path as *const i8) };
+    if let Ok(path_str) = c_str.to_str() {
+        RT.write()
+            .api_called(|| format!("rt_restore_image({path_str})"));
+        unwrap_result(package::restore_image(path_str), RT.write());
+    } else {
+        RT.write()
+            .error("Error in rt_restore_image: invalid string");
+    }
+}
+
 /// Calls [Runtime::breakpoint].
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_breakpoint() {
-    RT.write().unwrap().breakpoint();
+    profile_api!("rt_breakpoint");
+    RT.write().breakpoint();
 }
 
 /// Calls [Runtime::evaluated].
 #[unsafe(no_mangle)]
 pub extern "C" fn rt_evaluated(info: *const u8, optimized: i32) {
+    profile_api!("rt_evaluated");
     let c_str = unsafe { std::ffi::CStr::from_ptr(info as *const i8) };
-    let mut rt = RT.write().unwrap();
+    let rt = RT.write();
     if let Ok(info) = c_str.to_str() {
         rt.evaluated(info, optimized == 1);
     } else {
         rt.error("Error in rt_import: invalid string");
     }
 }
+
+/// Calls [Runtime::add_dbg_info]. Compiled units register each expression
+/// text at startup; evaluation sites then call [rt_evaluated_id] with the
+/// returned handle instead of crossing with the text itself. The handle
+/// round-trips through a per-module static exactly like
+/// [rt_pool_constant]'s, so registration is idempotent per context.
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_add_dbg_info(handle: usize, text: *const u8) -> usize {
+    profile_api!("rt_add_dbg_info");
+    let c_str = unsafe { std::ffi::CStr::from_ptr(text as *const i8) };
+    let rt = RT.write();
+    if let Ok(text) = c_str.to_str() {
+        if handle != usize::MAX && rt.has_dbg_info(handle) {
+            return handle;
+        }
+        let handle = if handle == usize::MAX {
+            runtime::alloc_dbg_handle()
+        } else {
+            handle
+        };
+        rt.add_dbg_info(handle, text.to_string());
+        handle
+    } else {
+        rt.error("Error in rt_add_dbg_info: invalid string");
+        0
+    }
+}
+
+/// Calls [Runtime::evaluated_id].
+#[unsafe(no_mangle)]
+pub extern "C" fn rt_evaluated_id(id: usize, optimized: i32) {
+    profile_api!("rt_evaluated_id");
+    RT.write().evaluated_id(id, optimized == 1);
+}
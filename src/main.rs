@@ -14,11 +14,11 @@ use relic::{
     error::ParseError,
     lexer::Lexer,
     logger::{LogLevel, log_debug, log_error, set_log_level},
-    node::Node,
-    package::file_to_node,
+    node::Ast,
+    package::{file_to_node, restore_image, save_image},
     parser::Parse,
     preprocess::PreProcess,
-    rt_start, run_node,
+    profile_report, rt_start, run_node,
     runtime::{DbgState, Runtime, StackMachine},
     unwrap_result,
 };
@@ -120,6 +120,16 @@ struct Cli {
     /// Whether to add debug information when compiling.
     #[arg(short = 'g')]
     debug_info: bool,
+
+    /// Restore a heap image at startup, before the input file runs
+    /// (repl and run modes).
+    #[arg(long, value_name = "FILE")]
+    restore_image: Option<PathBuf>,
+
+    /// Write a heap image of the warmed runtime: after the input file runs
+    /// (run mode) or when the session ends (repl mode).
+    #[arg(long, value_name = "FILE")]
+    save_image: Option<PathBuf>,
 }
 
 fn dbg_loop(runtime: &Runtime) -> DbgState {
@@ -153,6 +163,8 @@ fn dbg_loop(runtime: &Runtime) -> DbgState {
                         return DbgState::Normal;
                     }
                     "r" | "runtime" => log_debug(format!("{runtime}")),
+                    "gc" => log_debug(format!("{}", runtime.gc_stats())),
+                    "prof" | "profile" => log_debug(profile_report(runtime)),
                     input => {
                         match input
                             .strip_prefix("p ")
@@ -160,7 +172,7 @@ fn dbg_loop(runtime: &Runtime) -> DbgState {
                         {
                             Some(var) => {
                                 let env = runtime.current_env();
-                                let idx = env.get(&var.to_string(), runtime);
+                                let idx = env.get(var, runtime);
                                 match idx {
                                     Some(idx) => log_debug(format!(
                                         "{var} = {}",
@@ -170,7 +182,7 @@ fn dbg_loop(runtime: &Runtime) -> DbgState {
                                 };
                             }
                             None => log_error(
-                                "Wrong input. Available commands: (s)tep, (n)ext, (c)ontinue, (p)rint, (r)untime. Press C-d to quit.",
+                                "Wrong input. Available commands: (s)tep, (n)ext, (c)ontinue, (p)rint, (r)untime, gc, prof(ile). Press C-d to quit.",
                             ),
                         }
                     }
@@ -195,24 +207,41 @@ fn main() {
     let cli = Cli::parse();
 
     let mut macros = HashMap::new();
+    let mut ast = Ast::new();
     let input_node = cli
         .input_path
-        .map(|path| unwrap_result(file_to_node(path, &mut macros), &mut RT.write().unwrap()));
+        .map(|path| unwrap_result(file_to_node(path, &mut ast, &mut macros), RT.write()));
 
     match cli.mode {
         Mode::Run => {
             rt_start();
+            if let Some(path) = &cli.restore_image {
+                unwrap_result(restore_image(&path.to_string_lossy()), RT.write());
+            }
             if let Some(node) = input_node {
-                println!("result: {}", unwrap_result(run_node(node), &mut RT.write().unwrap()));
-            } else {
+                println!(
+                    "result: {}",
+                    unwrap_result(run_node(&mut ast, node), RT.write())
+                );
+            } else if cli.restore_image.is_none() {
                 eprintln!("No files to run");
             }
+            if let Some(path) = &cli.save_image {
+                unwrap_result(save_image(&path.to_string_lossy()), RT.write());
+            }
         }
         Mode::Repl => {
             rt_start();
 
+            if let Some(path) = &cli.restore_image {
+                unwrap_result(restore_image(&path.to_string_lossy()), RT.write());
+            }
+
             if let Some(node) = input_node {
-                println!("result: {}", unwrap_result(run_node(node), &mut RT.write().unwrap()));
+                println!(
+                    "result: {}",
+                    unwrap_result(run_node(&mut ast, node), RT.write())
+                );
             }
 
             // Gather autocomplete candidates from SYMBOLS and SPECIAL_FORMS
@@ -259,10 +288,13 @@ fn main() {
 
                         // Try to parse the input
                         let mut tokens = Lexer::new(&input_buffer);
-                        match Node::parse(&mut tokens) {
-                            Ok(mut node) => {
+                        match ast.parse(&mut tokens) {
+                            Ok(node) => {
                                 // Successful parse, execute and clear buffer
-                                match node.preprocess(&mut macros).and_then(run_node) {
+                                match ast
+                                    .preprocess(node, &mut macros)
+                                    .and_then(|node| run_node(&mut ast, node))
+                                {
                                     Ok(result) => {
                                         println!("= {result}");
                                         rl.add_history_entry(input_buffer.trim()).unwrap();
@@ -303,6 +335,10 @@ fn main() {
 
             // Save command history
             rl.save_history(".relic_history").unwrap();
+
+            if let Some(path) = &cli.save_image {
+                unwrap_result(save_image(&path.to_string_lossy()), RT.write());
+            }
         }
         Mode::Compile => {
             let mut codegen = match cli.package_name {
@@ -311,7 +347,10 @@ fn main() {
             };
             match input_node {
                 Some(node) => {
-                    unwrap_result(compile(&node, &mut codegen, cli.debug_info), &mut RT.write().unwrap());
+                    unwrap_result(
+                        compile(&mut ast, node, &mut codegen, cli.debug_info),
+                        RT.write(),
+                    );
                     match cli.output_path {
                         Some(output_path) => {
                             let mut output_file = File::create(output_path).unwrap();
@@ -334,12 +373,12 @@ fn main() {
                 rt_start();
                 set_log_level(LogLevel::Debug);
                 {
-                    let mut runtime = RT.write().unwrap();
+                    let runtime = RT.write();
                     runtime.set_callback(dbg_loop);
                     runtime.begin_debug();
                 }
-                unwrap_result(node.jit_compile(true), &mut RT.write().unwrap());
-                let mut runtime = RT.write().unwrap();
+                unwrap_result(ast.jit_compile(node, true), RT.write());
+                let runtime = RT.write();
                 let index = runtime.pop();
                 println!("result: {}", runtime.display_node_idx(index))
             }
@@ -1,18 +1,23 @@
 //! The data structure of node and other compiled-time objects.
 
 use std::{
-    cell::RefCell,
     collections::HashMap,
     fmt::{self, Display},
-    rc::Rc,
-    str::FromStr,
 };
 
 use crate::{
-    error::ParseError, lexer::{Lexer, Number}, nil, parser::Parse, symbol::{SpecialForm, Symbol}
+    error::ParseError,
+    lexer::{Lexer, Number},
+    nil,
+    parser::Parse,
+    symbol::{SpecialForm, Symbol, atom_name},
 };
 
-/// The data structure of the node in reference counting graph.
+/// A typed index into the [Ast] arena.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub struct NodeId(u32);
+
+/// The data structure of a node in the [Ast] arena.
 #[derive(Debug, Clone, PartialEq, Eq)]
 pub enum Node {
     /// Symbols.
@@ -21,28 +26,194 @@ pub enum Node {
     String(String),
     /// Numbers.
     Number(Number),
-    /// Pair of nodes.
-    Pair(Rc<RefCell<Node>>, Rc<RefCell<Node>>),
+    /// Pair of nodes, referred to by arena id.
+    Pair(NodeId, NodeId),
     /// An item of special form.
     SpecialForm(SpecialForm),
 }
 
-pub type NodePair = (Rc<RefCell<Node>>, Rc<RefCell<Node>>);
+/// Arena holding the compile-time program representation.
+///
+/// Nodes are allocated contiguously and referred to by [NodeId], so walking
+/// and rewriting trees touches no reference counts and performs no per-node
+/// allocations. Nodes are never mutated once added: rewrites
+/// ([Ast::replace], [Ast::substitute]) copy pairs only along the paths they
+/// change and share everything else, so trees can alias subtrees freely.
+pub struct Ast {
+    nodes: Vec<Node>,
+}
 
-impl Node {
-    pub fn as_user_symbol(&self) -> Result<String, String> {
-        match self {
-            Node::Symbol(Symbol::User(name)) => Ok(name.clone()),
-            _ => Err(format!("{self} is not a user defined symbol")),
+impl Default for Ast {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl Ast {
+    pub fn new() -> Self {
+        // Id 0 is the shared nil atom, see [Ast::nil].
+        Ast { nodes: vec![nil!()] }
+    }
+
+    pub fn add(&mut self, node: Node) -> NodeId {
+        self.nodes.push(node);
+        NodeId(self.nodes.len() as u32 - 1)
+    }
+
+    pub fn get(&self, id: NodeId) -> &Node {
+        &self.nodes[id.0 as usize]
+    }
+
+    pub fn get_mut(&mut self, id: NodeId) -> &mut Node {
+        &mut self.nodes[id.0 as usize]
+    }
+
+    /// The shared nil atom.
+    pub fn nil(&self) -> NodeId {
+        NodeId(0)
+    }
+
+    pub fn pair(&mut self, car: NodeId, cdr: NodeId) -> NodeId {
+        self.add(Node::Pair(car, cdr))
+    }
+
+    /// Build a proper list from the elements.
+    pub fn list(&mut self, elems: Vec<NodeId>) -> NodeId {
+        let mut cur = self.nil();
+        for elem in elems.into_iter().rev() {
+            cur = self.pair(elem, cur);
         }
+        cur
     }
 
-    pub fn as_pair(&self) -> Result<NodePair, String> {
-        match self {
-            Node::Pair(car, cdr) => Ok((car.clone(), cdr.clone())),
-            _ => Err(format!("{self} is not a pair")),
+    pub fn as_user_symbol(&self, id: NodeId) -> Result<String, String> {
+        match self.get(id) {
+            Node::Symbol(Symbol::User(name)) => Ok(atom_name(*name).to_string()),
+            _ => Err(format!("{} is not a user defined symbol", self.display(id))),
+        }
+    }
+
+    pub fn as_pair(&self, id: NodeId) -> Result<(NodeId, NodeId), String> {
+        match self.get(id) {
+            Node::Pair(car, cdr) => Ok((*car, *cdr)),
+            _ => Err(format!("{} is not a pair", self.display(id))),
+        }
+    }
+
+    /// Rewrite the tree rooted at `root`, substituting `dst` for every
+    /// subtree structurally equal to `src`, and return the rewritten root.
+    ///
+    /// The rewrite is copy-on-write: pairs are duplicated only along the
+    /// paths leading to an occurrence, everything else (including `root`
+    /// itself when nothing matches) is shared with the input. Trees may
+    /// therefore alias each other's subtrees without being affected by each
+    /// other's rewrites.
+    pub fn replace(&mut self, root: NodeId, src: NodeId, dst: NodeId) -> NodeId {
+        if self.structural_eq(root, src) {
+            return dst;
+        }
+        match *self.get(root) {
+            Node::Pair(car, cdr) => {
+                let new_car = self.replace(car, src, dst);
+                let new_cdr = self.replace(cdr, src, dst);
+                if new_car == car && new_cdr == cdr {
+                    root
+                } else {
+                    self.pair(new_car, new_cdr)
+                }
+            }
+            _ => root,
         }
     }
+
+    /// Instantiate the template rooted at `id`, substituting the node bound
+    /// to each user symbol that appears in `bindings`, and return the
+    /// instance.
+    ///
+    /// Like [Ast::replace] this is copy-on-write, and all holes are filled
+    /// in one pass instead of one tree walk per binding, so expanding a
+    /// macro costs O(path-to-holes) rather than O(template × bindings).
+    pub fn substitute(&mut self, id: NodeId, bindings: &HashMap<String, NodeId>) -> NodeId {
+        match *self.get(id) {
+            Node::Pair(car, cdr) => {
+                let new_car = self.substitute(car, bindings);
+                let new_cdr = self.substitute(cdr, bindings);
+                if new_car == car && new_cdr == cdr {
+                    id
+                } else {
+                    self.pair(new_car, new_cdr)
+                }
+            }
+            Node::Symbol(Symbol::User(name)) => {
+                bindings.get(atom_name(name)).copied().unwrap_or(id)
+            }
+            _ => id,
+        }
+    }
+
+    /// Structural (deep) equality of two trees.
+    pub fn structural_eq(&self, a: NodeId, b: NodeId) -> bool {
+        let mut work = vec![(a, b)];
+        while let Some((a, b)) = work.pop() {
+            if a == b {
+                continue;
+            }
+            match (self.get(a), self.get(b)) {
+                (Node::Pair(a_car, a_cdr), Node::Pair(b_car, b_cdr)) => {
+                    work.push((*a_car, *b_car));
+                    work.push((*a_cdr, *b_cdr));
+                }
+                (x, y) => {
+                    if x != y {
+                        return false;
+                    }
+                }
+            }
+        }
+        true
+    }
+
+    /// Parse a whole program, wrapping the statements in a `(begin ...)`
+    /// node.
+    pub fn parse_str(&mut self, s: &str) -> Result<NodeId, String> {
+        let mut tokens = Lexer::new(s);
+        let mut nodes = vec![];
+        loop {
+            if let Err(ParseError::EOF) = tokens.peek_next_token() {
+                let begin = self.add(Node::SpecialForm(SpecialForm::Begin));
+                let body = self.list(nodes);
+                return Ok(self.pair(begin, body));
+            }
+            nodes.push(self.parse(&mut tokens).map_err(|e| e.to_string())?);
+        }
+    }
+
+    /// Convert a node to a [Pattern].
+    pub fn pattern(&self, id: NodeId) -> Result<Pattern, String> {
+        match self.get(id) {
+            Node::Symbol(Symbol::User(str)) => Ok(Pattern::Symbol(atom_name(*str).to_string())),
+            &Node::Pair(car, cdr) => {
+                if let Node::Symbol(Symbol::User(sym)) = self.get(car) {
+                    Ok(Pattern::Pair(
+                        atom_name(*sym).to_string(),
+                        Box::new(self.pattern(cdr)?),
+                    ))
+                } else {
+                    Err(format!("{} is not a list", self.display(id)))
+                }
+            }
+            nil!() => Ok(Pattern::Nil),
+            _ => Err(format!(
+                "Can't transform node {} to pattern",
+                self.display(id)
+            )),
+        }
+    }
+
+    /// Display the tree rooted at `id`.
+    pub fn display(&self, id: NodeId) -> AstDisplay<'_> {
+        AstDisplay { ast: self, id }
+    }
 }
 
 /// The data structure of a pattern. A pattern is a improper list consists of
@@ -78,19 +249,20 @@ impl Pattern {
 }
 
 pub fn pattern_matching(
+    ast: &mut Ast,
     pattern: &Pattern,
-    actual: &[Rc<RefCell<Node>>],
-    bindings: &mut HashMap<String, Rc<RefCell<Node>>>,
+    actual: &[NodeId],
+    bindings: &mut HashMap<String, NodeId>,
 ) -> Result<(), String> {
     match (pattern, actual) {
         (Pattern::Symbol(sym), x) => {
-            let node = Node::from_iter(x.iter().cloned());
-            bindings.insert(sym.to_string(), node.into());
+            let node = ast.list(x.to_vec());
+            bindings.insert(sym.to_string(), node);
             Ok(())
         }
-        (Pattern::Pair(car, cdr), &[ref head, ref tail @ ..]) => {
-            bindings.insert(car.clone(), head.clone());
-            pattern_matching(cdr, tail, bindings)
+        (Pattern::Pair(car, cdr), &[head, ref tail @ ..]) => {
+            bindings.insert(car.clone(), head);
+            pattern_matching(ast, cdr, tail, bindings)
         }
         (Pattern::Nil, []) => Ok(()),
         _ => Err(format!(
@@ -99,125 +271,118 @@ pub fn pattern_matching(
     }
 }
 
-impl From<Pattern> for Node {
-    fn from(value: Pattern) -> Self {
-        match value {
-            Pattern::Symbol(str) => Node::Symbol(Symbol::User(str)),
-            Pattern::Pair(car, cdr) => Node::Pair(
-                Rc::new(RefCell::new(Node::Symbol(Symbol::User(car)))),
-                Rc::new(RefCell::new(Self::from(*cdr))),
-            ),
-            Pattern::Nil => nil!(),
-        }
-    }
-}
-
-impl TryFrom<Rc<RefCell<Node>>> for Pattern {
-    type Error = String;
-    fn try_from(value: Rc<RefCell<Node>>) -> Result<Self, Self::Error> {
-        match &*value.borrow() {
-            Node::Symbol(Symbol::User(str)) => Ok(Self::Symbol(str.clone())),
-            Node::Pair(car, cdr) => {
-                if let Node::Symbol(Symbol::User(sym)) = &*car.borrow() {
-                    Ok(Self::Pair(sym.clone(), Box::new(cdr.clone().try_into()?)))
-                } else {
-                    Err(format!("{} is not a list", value.borrow()))
+impl Display for Pattern {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        match self {
+            Pattern::Symbol(sym) => write!(f, "{sym}"),
+            Pattern::Nil => write!(f, "{}", Symbol::Nil),
+            Pattern::Pair(..) => {
+                write!(f, "(")?;
+                let mut cur = self;
+                while let Pattern::Pair(car, cdr) = cur {
+                    write!(f, "{car}")?;
+                    match &**cdr {
+                        Pattern::Nil => break,
+                        Pattern::Symbol(sym) => {
+                            write!(f, " . {sym}")?;
+                            break;
+                        }
+                        pair => {
+                            write!(f, " ")?;
+                            cur = pair;
+                        }
+                    }
                 }
+                write!(f, ")")
             }
-            nil!() => Ok(Pattern::Nil),
-            _ => Err(format!(
-                "Can't transform node {} to pattern",
-                value.borrow()
-            )),
         }
     }
 }
 
-impl Display for Pattern {
-    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
-        write!(f, "{}", Node::from(self.clone()))
-    }
+/// A tree in an [Ast], bundled with the arena for [Display].
+pub struct AstDisplay<'a> {
+    ast: &'a Ast,
+    id: NodeId,
 }
 
-impl Display for Node {
+impl Display for AstDisplay<'_> {
     fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
         let mut visited = HashMap::new();
-        self.fmt_with_visited(f, &mut visited, 0)
+        self.ast.fmt_with_visited(self.id, f, &mut visited, 0)
     }
 }
 
-impl Node {
+impl Ast {
+    /// Insert `id` into the visited map if it is a pair. Atoms are shared
+    /// across trees, so tracking them would print spurious `#n#` references;
+    /// cycles can only go through pairs.
+    fn visit(&self, visited: &mut HashMap<NodeId, usize>, id: NodeId, disp_id: usize) {
+        if matches!(self.get(id), Node::Pair(..)) {
+            visited.insert(id, disp_id);
+        }
+    }
+
     fn fmt_with_visited(
         &self,
+        id: NodeId,
         f: &mut fmt::Formatter<'_>,
-        visited: &mut HashMap<*const Node, usize>,
-        id: usize,
+        visited: &mut HashMap<NodeId, usize>,
+        disp_id: usize,
     ) -> fmt::Result {
-        match self {
+        match self.get(id) {
             Node::String(value) => write!(f, "\"{value}\""),
             Node::Number(num) => write!(f, "{num}"),
             Node::SpecialForm(sym) => write!(f, "{sym}"),
             Node::Symbol(sym) => write!(f, "{sym}"),
-            Node::Pair(car, cdr) => {
-                let cdr_ptr = cdr.as_ptr() as *const Node;
-                if let Some(prev_id) = visited.get(&cdr_ptr) {
+            &Node::Pair(car, cdr) => {
+                if let Some(prev_id) = visited.get(&cdr) {
                     return write!(f, "#{prev_id}#");
                 }
-                visited.insert(cdr_ptr, id);
+                self.visit(visited, cdr, disp_id);
 
-                let car_ptr = car.as_ptr() as *const Node;
-                if let Some(prev_id) = visited.get(&car_ptr) {
+                if let Some(prev_id) = visited.get(&car) {
                     write!(f, "(#{prev_id}#")?;
                 } else {
                     write!(f, "(")?;
-                    car.borrow().fmt_with_visited(f, visited, id)?;
-                    visited.insert(car_ptr, id);
+                    self.fmt_with_visited(car, f, visited, disp_id)?;
+                    self.visit(visited, car, disp_id);
                 }
 
-                let mut current = cdr.clone();
-                let mut current_id = id;
+                let mut current = cdr;
+                let mut current_id = disp_id;
                 loop {
-                    let next = {
-                        let node = current.borrow();
-                        match &*node {
-                            Node::Pair(next_car, next_cdr) => {
-                                let cdr_ptr = next_cdr.as_ptr() as *const Node;
-
-                                if let Some(prev_id) = visited.get(&cdr_ptr) {
-                                    write!(f, " . #{prev_id}#",)?;
-                                    break;
-                                }
-
-                                let next_id = current_id + 1;
-                                visited.insert(cdr_ptr, next_id);
-
-                                let car_ptr = next_car.as_ptr() as *const Node;
-                                if let Some(prev_id) = visited.get(&car_ptr) {
-                                    write!(f, " #{prev_id}#",)?;
-                                } else {
-                                    write!(f, " ")?;
-                                    next_car.borrow().fmt_with_visited(f, visited, next_id)?;
-                                    visited.insert(car_ptr, next_id);
-                                }
-                                Some((next_cdr.clone(), next_id))
-                            }
-                            Node::Symbol(Symbol::Nil) => None,
-                            Node::Number(_)
-                            | Node::Symbol(_)
-                            | Node::SpecialForm(_)
-                            | Node::String(_) => {
-                                write!(f, " . {node}")?;
-                                None
+                    match *self.get(current) {
+                        Node::Pair(next_car, next_cdr) => {
+                            if let Some(prev_id) = visited.get(&next_cdr) {
+                                write!(f, " . #{prev_id}#")?;
+                                break;
                             }
-                        }
-                    };
 
-                    match next {
-                        Some((next_cdr, next_id)) => {
+                            let next_id = current_id + 1;
+                            self.visit(visited, next_cdr, next_id);
+
+                            if let Some(prev_id) = visited.get(&next_car) {
+                                write!(f, " #{prev_id}#")?;
+                            } else {
+                                write!(f, " ")?;
+                                self.fmt_with_visited(next_car, f, visited, next_id)?;
+                                self.visit(visited, next_car, next_id);
+                            }
                             current = next_cdr;
                             current_id = next_id;
                         }
-                        None => break,
+                        Node::Symbol(Symbol::Nil) => break,
+                        ref node => {
+                            write!(f, " . ")?;
+                            match node {
+                                Node::String(value) => write!(f, "\"{value}\"")?,
+                                Node::Number(num) => write!(f, "{num}")?,
+                                Node::SpecialForm(sym) => write!(f, "{sym}")?,
+                                Node::Symbol(sym) => write!(f, "{sym}")?,
+                                Node::Pair(..) => unreachable!(),
+                            }
+                            break;
+                        }
                     }
                 }
                 write!(f, ")")
@@ -225,41 +390,3 @@ impl Node {
         }
     }
 }
-
-impl<T> FromIterator<T> for Node
-where
-    T: Into<Rc<RefCell<Node>>>,
-{
-    fn from_iter<It: IntoIterator<Item = T>>(iter: It) -> Self {
-        let items: Vec<_> = iter.into_iter().collect();
-        let mut cur = nil!();
-        for value in items.into_iter().rev() {
-            cur = Node::Pair(value.into(), cur.into())
-        }
-        cur
-    }
-}
-
-impl From<Node> for Rc<RefCell<Node>> {
-    fn from(value: Node) -> Self {
-        RefCell::new(value).into()
-    }
-}
-
-impl FromStr for Node {
-    type Err = String;
-    fn from_str(s: &str) -> Result<Self, Self::Err> {
-        let mut tokens = Lexer::new(s);
-        let mut nodes = vec![];
-        loop {
-            if let Err(ParseError::EOF) = tokens.peek_next_token() {
-                // Create a `(begin ...)` node
-                return Ok(Node::Pair(
-                    Node::SpecialForm(SpecialForm::Begin).into(),
-                    Node::from_iter(nodes).into(),
-                ));
-            }
-            nodes.push(Node::parse(&mut tokens).map_err(|e| e.to_string())?);
-        }
-    }
-}
@@ -0,0 +1,191 @@
+//! The optimizer module.
+//!
+//! An [Optimize] pass runs on the preprocessed tree, before code
+//! generation. It folds arithmetic and comparisons whose operands are all
+//! literal numbers, prunes `if` branches whose condition is decided at
+//! compile time, and drops value-discarded pure expressions from `begin`.
+//!
+//! Rewrites are copy-on-write like the preprocessor's: an unchanged subtree
+//! is returned as-is, and nodes are never mutated in place. Anything the
+//! pass cannot prove is left for the runtime, so error behaviour (e.g. an
+//! arity mismatch in `(+ 1)`) is unchanged.
+
+use crate::{
+    lexer::Number,
+    node::{Ast, Node, NodeId},
+    symbol::{SpecialForm, Symbol},
+    util::{eval_arith, eval_rel, get_n_params, vectorize},
+    vec_to_list,
+};
+
+pub trait Optimize {
+    /// Optimize the tree rooted at `node` and return the optimized root.
+    fn optimize(&mut self, node: NodeId) -> NodeId;
+}
+
+impl Optimize for Ast {
+    fn optimize(&mut self, node: NodeId) -> NodeId {
+        let Node::Pair(old_car, old_cdr) = *self.get(node) else {
+            return node;
+        };
+        match *self.get(old_car) {
+            // Quoted data is data: nothing inside is evaluated.
+            Node::SpecialForm(SpecialForm::Quote) => node,
+            Node::SpecialForm(SpecialForm::If) => self.optimize_if(node, old_cdr),
+            Node::SpecialForm(SpecialForm::Begin) => self.optimize_begin(node, old_car, old_cdr),
+            // Everything else (applications and the remaining special
+            // forms) optimizes elementwise; lambda patterns and definition
+            // names are symbols, which the pass never touches.
+            _ => self.optimize_application(node),
+        }
+    }
+}
+
+impl Ast {
+    /// Optimize each element of a list form, then try to fold the rebuilt
+    /// node. Only the node itself is in expression position: the interior
+    /// pairs are the operand list's spine, and folding one of them would
+    /// rewrite an operand tail — the `(+ 1 2)` inside `(f + 1 2)` — into a
+    /// value, leaving an improper call. Improper lists are left for the
+    /// compiler's usual error.
+    fn optimize_application(&mut self, node: NodeId) -> NodeId {
+        let Ok(elements) = vectorize(self, node) else {
+            return node;
+        };
+        let mut changed = false;
+        let mut optimized = Vec::with_capacity(elements.len());
+        for element in &elements {
+            let opt = self.optimize(*element);
+            changed |= opt != *element;
+            optimized.push(opt);
+        }
+        let node = if changed {
+            let mut list = self.nil();
+            for element in optimized.into_iter().rev() {
+                list = self.pair(element, list);
+            }
+            list
+        } else {
+            node
+        };
+        self.fold_application(node)
+    }
+
+    /// Fold an application of an arithmetic or comparison primitive whose
+    /// operands are all literal numbers, using the same [eval_arith] and
+    /// [eval_rel] the runtime dispatches to so the folded value matches
+    /// what execution would produce. Anything else — including expressions
+    /// the runtime would reject — is returned unchanged.
+    fn fold_application(&mut self, node: NodeId) -> NodeId {
+        let Node::Pair(car, cdr) = *self.get(node) else {
+            return node;
+        };
+        let Node::Symbol(op) = *self.get(car) else {
+            return node;
+        };
+        let Ok(params) = vectorize(self, cdr) else {
+            return node;
+        };
+        let Some(numbers) = params
+            .iter()
+            .map(|param| match self.get(*param) {
+                Node::Number(num) => Some(num.clone()),
+                _ => None,
+            })
+            .collect::<Option<Vec<Number>>>()
+        else {
+            return node;
+        };
+
+        let folded = match op {
+            Symbol::Add => eval_arith(numbers, |a, b| a + b).map(Node::Number),
+            Symbol::Sub => eval_arith(numbers, |a, b| a - b).map(Node::Number),
+            Symbol::Mul => eval_arith(numbers, |a, b| a * b).map(Node::Number),
+            Symbol::Div => eval_arith(numbers, |a, b| a / b).map(Node::Number),
+            Symbol::EqNum => eval_rel(numbers, |a, b| a == b).map(Node::Symbol),
+            Symbol::Gt => eval_rel(numbers, |a, b| a > b).map(Node::Symbol),
+            Symbol::Lt => eval_rel(numbers, |a, b| a < b).map(Node::Symbol),
+            Symbol::Ge => eval_rel(numbers, |a, b| a >= b).map(Node::Symbol),
+            Symbol::Le => eval_rel(numbers, |a, b| a <= b).map(Node::Symbol),
+            _ => return node,
+        };
+        match folded {
+            Ok(value) => self.add(value),
+            Err(_) => node,
+        }
+    }
+
+    /// Prune an `if` whose condition is a literal: only `nil` is false (see
+    /// `rt_get_bool`), so a literal number, string or `t` selects the then
+    /// branch at compile time. Malformed `if`s fall through to the compiler
+    /// for its usual error.
+    fn optimize_if(&mut self, node: NodeId, cdr: NodeId) -> NodeId {
+        let Ok(params) = get_n_params(self, cdr, 3) else {
+            return node;
+        };
+        let cond = self.optimize(params[0]);
+        match *self.get(cond) {
+            Node::Number(_) | Node::String(_) | Node::Symbol(Symbol::T) => {
+                self.optimize(params[1])
+            }
+            Node::Symbol(Symbol::Nil) => self.optimize(params[2]),
+            _ => {
+                let then_branch = self.optimize(params[1]);
+                let else_branch = self.optimize(params[2]);
+                if cond == params[0] && then_branch == params[1] && else_branch == params[2] {
+                    node
+                } else {
+                    let Node::Pair(if_form, _) = *self.get(node) else {
+                        unreachable!()
+                    };
+                    vec_to_list!(self, if_form, cond, then_branch, else_branch)
+                }
+            }
+        }
+    }
+
+    /// Drop pure expressions from the non-final positions of a `begin`:
+    /// their value is discarded and evaluating them has no effect. Symbols
+    /// are kept — looking up an unbound one is an observable error.
+    fn optimize_begin(&mut self, node: NodeId, car: NodeId, cdr: NodeId) -> NodeId {
+        let Ok(operands) = vectorize(self, cdr) else {
+            return node;
+        };
+        if operands.is_empty() {
+            return node;
+        }
+        let mut changed = false;
+        let mut kept = vec![];
+        let last = operands.len() - 1;
+        for (i, operand) in operands.iter().enumerate() {
+            let operand = self.optimize(*operand);
+            changed |= operand != operands[i];
+            if i != last && self.is_pure_value(operand) {
+                changed = true;
+                continue;
+            }
+            kept.push(operand);
+        }
+        if !changed {
+            return node;
+        }
+        let mut list = self.nil();
+        for operand in kept.into_iter().rev() {
+            list = self.pair(operand, list);
+        }
+        self.pair(car, list)
+    }
+
+    /// Whether evaluating the expression can have no side effect and no
+    /// failure, so a value-discarded occurrence can be dropped outright.
+    fn is_pure_value(&self, id: NodeId) -> bool {
+        match self.get(id) {
+            Node::Number(_) | Node::String(_) => true,
+            Node::Symbol(sym) => !matches!(sym, Symbol::User(_)),
+            Node::Pair(car, _) => {
+                matches!(self.get(*car), Node::SpecialForm(SpecialForm::Quote))
+            }
+            _ => false,
+        }
+    }
+}
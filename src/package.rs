@@ -5,7 +5,6 @@ use std::{
     fs::read_to_string,
     path::{Path, PathBuf},
     process::Command,
-    str::FromStr,
 };
 
 use libloading::{Library, Symbol};
@@ -13,25 +12,53 @@ use libloading::{Library, Symbol};
 use crate::{
     RT,
     compile::{CodeGen, compile},
-    node::Node,
+    node::{Ast, NodeId},
     preprocess::{Macro, PreProcess},
-    util::inc,
+    runtime::StackMachine,
 };
 
-/// Reads text from a file, parses and preprocesses it, then returns a node.
+/// Reads text from a file, parses and preprocesses it into `ast`, then
+/// returns the id of the resulting node.
 pub fn file_to_node(
     input_path: PathBuf,
+    ast: &mut Ast,
     macros: &mut HashMap<String, Macro>,
-) -> Result<Node, String> {
+) -> Result<NodeId, String> {
     let file = read_to_string(input_path).map_err(|e| e.to_string())?;
-    let mut node = Node::from_str(&file)?;
-    node.preprocess(macros)
+    let node = ast.parse_str(&file)?;
+    ast.preprocess(node, macros)
+}
+
+/// Compiler version mixed into cache keys, so shared objects built by
+/// another version of the compiler are never reused.
+const COMPILER_VERSION: &str = env!("CARGO_PKG_VERSION");
+
+/// FNV-1a hash of a package source. Cheap, dependency-free and stable
+/// across runs, which is all the cache key needs.
+fn source_hash(source: &str) -> u64 {
+    let mut hash: u64 = 0xcbf29ce484222325;
+    for byte in source.bytes().chain(COMPILER_VERSION.bytes()) {
+        hash ^= byte as u64;
+        hash = hash.wrapping_mul(0x100000001b3);
+    }
+    hash
+}
+
+/// Path of the cached shared object for package `name` whose source hashes
+/// to `hash`, or `None` when no cache directory is available.
+fn cache_path(name: &str, hash: u64) -> Option<PathBuf> {
+    let cache_dir = std::env::var_os("XDG_CACHE_HOME")
+        .map(PathBuf::from)
+        .or_else(|| std::env::var_os("HOME").map(|home| PathBuf::from(home).join(".cache")))?;
+    Some(cache_dir.join("relic").join(format!("{name}-{hash:016x}.relic")))
 }
 
 /// Loads a package to the runtime.
-/// 
+///
 /// A package with name `name` can be either a dynamic library `name.relic` or
-/// a Lisp source file `name.lisp`.
+/// a Lisp source file `name.lisp`. Compiled sources are cached under the
+/// user's cache directory keyed by their content hash, so importing an
+/// unchanged package is a `dlopen` and nothing else.
 ///
 /// This function can not be called when holding [RT].
 pub fn load_package(name: &str) -> Result<(), String> {
@@ -41,8 +68,29 @@ pub fn load_package(name: &str) -> Result<(), String> {
         let lib = load_binary_library(&binary_name)?;
         add_package(lib, name)
     } else if Path::new(&text_name).exists() {
-        let node = file_to_node(PathBuf::from(text_name), &mut HashMap::new())?;
-        node.jit_compile(true)
+        let source = read_to_string(&text_name).map_err(|e| e.to_string())?;
+        let cached = cache_path(name, source_hash(&source));
+        if let Some(path) = &cached {
+            if path.exists() {
+                let lib = load_binary_library(&path.to_string_lossy())?;
+                return add_package(lib, name);
+            }
+        }
+        let mut ast = Ast::new();
+        let node = ast.parse_str(&source)?;
+        let node = ast.preprocess(node, &mut HashMap::new())?;
+        let lib_full_name = compile_to_library(&mut ast, node, name, true)?;
+        // Populating the cache is best-effort; a read-only cache directory
+        // only costs the next start a recompile.
+        if let Some(path) = &cached {
+            let _ = path
+                .parent()
+                .ok_or(())
+                .and_then(|dir| std::fs::create_dir_all(dir).map_err(|_| ()))
+                .and_then(|_| std::fs::copy(&lib_full_name, path).map_err(|_| ()));
+        }
+        let lib = load_binary_library(&lib_full_name)?;
+        add_package(lib, name)
     } else {
         Err(format!("library {name} not found"))
     }
@@ -53,7 +101,7 @@ pub fn load_package(name: &str) -> Result<(), String> {
 /// This function can not be called when holding [RT].
 fn add_package(lib: Library, name: &str) -> Result<(), String> {
     call_library_fn(&lib, name)?;
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.add_package(name.to_string(), lib);
     Ok(())
 }
@@ -63,6 +111,28 @@ fn load_binary_library(name: &str) -> Result<Library, String> {
     unsafe { Library::new(name) }.map_err(|e| e.to_string())
 }
 
+/// Re-runs the startup function of a package that is already loaded in
+/// this process.
+///
+/// This function can not be called when holding [RT]: the function pointer
+/// is copied out before the call, because the startup code re-enters the
+/// runtime through [RT] itself.
+fn call_package_fn(name: &str) -> Result<(), String> {
+    let func = {
+        let runtime = RT.read();
+        let lib = runtime.get_package(name);
+        let func: Symbol<unsafe extern "C" fn() -> i32> =
+            unsafe { lib.get(&name.to_string().into_bytes()) }.map_err(|e| e.to_string())?;
+        *func
+    };
+    let ret_val = unsafe { func() };
+    if ret_val == 0 {
+        Ok(())
+    } else {
+        Err(format!("function {name} returns {ret_val}"))
+    }
+}
+
 /// Calls the main function of a library.
 ///
 /// This function can not be called when holding [RT].
@@ -80,50 +150,169 @@ fn call_library_fn(lib: &Library, func_name: &str) -> Result<(), String> {
     }
 }
 
+/// Compiles a node to a shared object exporting `int {lib_name}()` and
+/// returns the path of the object.
+fn compile_to_library(
+    ast: &mut Ast,
+    node: NodeId,
+    lib_name: &str,
+    debug_info: bool,
+) -> Result<String, String> {
+    // make a directory for Relic runtime if it doesn't exist
+    std::fs::create_dir_all("/tmp/relic").map_err(|e| e.to_string())?;
+
+    let c_source_name = format!("/tmp/relic/{lib_name}.c");
+    let lib_full_name = format!("/tmp/relic/{lib_name}.relic");
+
+    // node -> .c
+    let mut codegen = CodeGen::new_library(lib_name.to_string());
+    compile(ast, node, &mut codegen, debug_info)?;
+    let c_code = codegen.to_string();
+    std::fs::write(&c_source_name, c_code).map_err(|e| e.to_string())?;
+
+    // .c -> .relic
+    let status = Command::new("gcc")
+        .args([
+            "-Ic_runtime",
+            "-shared",
+            "-fPIC",
+            "-O3",
+            "-g",
+            "-o",
+            &lib_full_name,
+            &c_source_name,
+            #[cfg(target_os = "macos")]
+            "-Wl,-undefined,dynamic_lookup",
+        ])
+        .spawn()
+        .map_err(|e| e.to_string())?
+        .wait()
+        .map_err(|e| e.to_string())?;
+    if status.success() {
+        Ok(lib_full_name)
+    } else {
+        Err(format!("compilation failed with status {status}"))
+    }
+}
+
 /// JIT compile a pre-processed, compile-time node, and load it to the static runtime.
 /// It has the same effect as evaluating the node at top-level.
 ///
+/// Units are keyed by the hash of the node's printed form, so evaluating
+/// the same expression again never touches the C toolchain: a unit
+/// compiled earlier in this process just re-runs its startup function (no
+/// duplicate [Library] accumulates in the package table), and one compiled
+/// in an earlier session is a `dlopen` from the cache directory, like an
+/// unchanged package in [load_package].
+///
 /// This function can not be called when holding [RT].
-impl Node {
-    pub fn jit_compile(&self, debug_info: bool) -> Result<(), String> {
-        // make a directory for Relic runtime if it doesn't exist
-        std::fs::create_dir_all("/tmp/relic").map_err(|e| e.to_string())?;
-
-        let lib_name = format!("jit_{}", inc());
-        let c_source_name = format!("/tmp/relic/{lib_name}.c");
-        let lib_full_name = format!("/tmp/relic/{lib_name}.relic");
-
-        // node -> .c
-        let mut codegen = CodeGen::new_library(lib_name.to_string());
-        compile(self, &mut codegen, debug_info)?;
-        let c_code = codegen.to_string();
-        std::fs::write(&c_source_name, c_code).map_err(|e| e.to_string())?;
-
-        // .c -> .relic
-        let status = Command::new("gcc")
-            .args([
-                "-Ic_runtime",
-                "-shared",
-                "-fPIC",
-                "-O3",
-                "-g",
-                "-o",
-                &lib_full_name,
-                &c_source_name,
-                #[cfg(target_os = "macos")]
-                "-Wl,-undefined,dynamic_lookup",
-            ])
-            .spawn()
-            .map_err(|e| e.to_string())?
-            .wait()
-            .map_err(|e| e.to_string())?;
-        if status.success() {
-            Ok(())
-        } else {
-            Err(format!("compilation failed with status {status}"))
-        }?;
+impl Ast {
+    pub fn jit_compile(&mut self, node: NodeId, debug_info: bool) -> Result<(), String> {
+        // Key the unit by its preprocessed, printed form: however the raw
+        // input was spelled, the same expression maps to the same unit.
+        // The debug flag changes the generated C, so it is part of the key.
+        let source = format!("{}\n;dbg={debug_info}", self.display(node));
+        let hash = source_hash(&source);
+        let lib_name = format!("jit_{hash:016x}");
+
+        if RT.read().has_package(&lib_name) {
+            call_package_fn(&lib_name)?;
+            RT.write().log_jit_unit(&lib_name);
+            return Ok(());
+        }
 
+        let cached = cache_path(&lib_name, hash);
+        if let Some(path) = &cached {
+            if path.exists() {
+                let lib = load_binary_library(&path.to_string_lossy())?;
+                add_package(lib, &lib_name)?;
+                RT.write().log_jit_unit(&lib_name);
+                return Ok(());
+            }
+        }
+
+        let lib_full_name = compile_to_library(self, node, &lib_name, debug_info)?;
+        // Populating the cache is best-effort, as in [load_package].
+        if let Some(path) = &cached {
+            let _ = path
+                .parent()
+                .ok_or(())
+                .and_then(|dir| std::fs::create_dir_all(dir).map_err(|_| ()))
+                .and_then(|_| std::fs::copy(&lib_full_name, path).map_err(|_| ()));
+        }
         let lib = load_binary_library(&lib_full_name)?;
-        add_package(lib, &lib_name)
+        add_package(lib, &lib_name)?;
+        RT.write().log_jit_unit(&lib_name);
+        Ok(())
     }
 }
+
+/// The cache path of a JIT unit, derived from the hash embedded in its
+/// name.
+fn unit_cache_path(name: &str) -> Result<PathBuf, String> {
+    let hash = name
+        .strip_prefix("jit_")
+        .and_then(|hash| u64::from_str_radix(hash, 16).ok())
+        .ok_or_else(|| format!("{name} is not a JIT unit"))?;
+    cache_path(name, hash).ok_or_else(|| "no cache directory available".to_string())
+}
+
+/// Write a heap image of the running runtime to `path`.
+///
+/// The image is the manifest of the top-level JIT units executed so far, in
+/// order. The runtime state cannot be dumped as raw bytes — closure bodies
+/// are function pointers into per-unit shared objects, each with its own
+/// static symbol and constant handles — so the image records *how* the
+/// state was built and [restore_image] replays it from the binary cache:
+/// a `dlopen` and a run of already-compiled code per unit, never the C
+/// toolchain. Every unit's cached object is verified here, so a missing
+/// one fails at save time rather than at restore.
+///
+/// This function can not be called when holding [RT].
+pub fn save_image(path: &str) -> Result<(), String> {
+    let mut out = format!("relic-image {COMPILER_VERSION}\n");
+    {
+        let runtime = RT.read();
+        for name in runtime.jit_log() {
+            if !unit_cache_path(name)?.exists() {
+                return Err(format!("compiled unit {name} is not in the cache"));
+            }
+            out.push_str(name);
+            out.push('\n');
+        }
+    }
+    std::fs::write(path, out).map_err(|e| e.to_string())
+}
+
+/// Restore a heap image written by [save_image]: replay every unit in the
+/// manifest from the binary cache, in order, on a freshly started runtime.
+/// Imports inside a unit re-run through `rt_import` as they did during
+/// warm-up. Each unit leaves its value on the stack exactly as evaluating
+/// it would; the value is popped, as the REPL does after [Ast::jit_compile].
+///
+/// This function can not be called when holding [RT].
+pub fn restore_image(path: &str) -> Result<(), String> {
+    let text = read_to_string(path).map_err(|e| e.to_string())?;
+    let mut lines = text.lines();
+    let header = lines.next().unwrap_or_default();
+    if header != format!("relic-image {COMPILER_VERSION}") {
+        return Err(format!(
+            "{path} is not a heap image for compiler version {COMPILER_VERSION}"
+        ));
+    }
+    for name in lines.filter(|line| !line.is_empty()) {
+        if RT.read().has_package(name) {
+            call_package_fn(name)?;
+        } else {
+            let cached = unit_cache_path(name)?;
+            let lib = load_binary_library(&cached.to_string_lossy())?;
+            add_package(lib, name)?;
+        }
+        let runtime = RT.write();
+        runtime.pop();
+        // Re-log the unit, so an image saved after a restore still covers
+        // the whole warm-up.
+        runtime.log_jit_unit(name);
+    }
+    Ok(())
+}
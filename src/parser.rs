@@ -4,16 +4,15 @@ use std::str::FromStr;
 
 use crate::error::ParseError;
 use crate::lexer::{Lexer, TokenType};
-use crate::nil;
-use crate::node::Node;
-use crate::symbol::{SpecialForm, Symbol};
+use crate::node::{Ast, Node, NodeId};
+use crate::symbol::SpecialForm;
 
 pub trait Parse {
-    fn parse(tokens: &mut Lexer) -> Result<Self, ParseError>
-    where
-        Self: Sized;
+    /// Parse one expression from `tokens` into the arena and return its id.
+    fn parse(&mut self, tokens: &mut Lexer) -> Result<NodeId, ParseError>;
 }
-impl Node {
+
+impl Ast {
     /// Parse the list according to the following BNF:
     ///
     /// ```ignore
@@ -24,59 +23,67 @@ impl Node {
     /// ```
     ///
     /// The `Lparem` and `SpecialForm` are already stripped when the function is called.
-    fn parse_list(tokens: &mut Lexer) -> Result<Self, ParseError> {
-        match tokens.peek_next_token() {
-            Ok((_, TokenType::RParem)) => {
-                // case 1
-                tokens.consume(TokenType::RParem)?;
-                Ok(nil!())
-            }
-            _ => {
-                let car = Node::parse(tokens)?;
-                let cdr = if let Ok((_, TokenType::Dot)) = tokens.peek_next_token() {
-                    // case 2
-                    tokens.consume(TokenType::Dot)?;
-                    let cdr = Node::parse(tokens)?;
+    ///
+    /// The elements are collected in a loop and folded into pairs at the
+    /// closing `)`, so list length is not limited by the Rust call stack.
+    fn parse_list(&mut self, tokens: &mut Lexer) -> Result<NodeId, ParseError> {
+        let mut elems: Vec<NodeId> = vec![];
+        loop {
+            match tokens.peek_next_token() {
+                Ok((_, TokenType::RParem)) => {
+                    // case 1
                     tokens.consume(TokenType::RParem)?;
-                    cdr
-                } else {
+                    return Ok(self.list(elems));
+                }
+                Ok((_, TokenType::Dot)) if !elems.is_empty() => {
                     // case 3
-                    Self::parse_list(tokens)?
-                };
-
-                Ok(Node::Pair(car.into(), cdr.into()))
+                    tokens.consume(TokenType::Dot)?;
+                    let mut cur = self.parse(tokens)?;
+                    tokens.consume(TokenType::RParem)?;
+                    for elem in elems.into_iter().rev() {
+                        cur = self.pair(elem, cur);
+                    }
+                    return Ok(cur);
+                }
+                _ => {
+                    // case 2
+                    let elem = self.parse(tokens)?;
+                    elems.push(elem);
+                }
             }
         }
     }
 }
 
-impl Parse for Node {
-    fn parse(tokens: &mut Lexer) -> Result<Self, ParseError> {
+impl Parse for Ast {
+    fn parse(&mut self, tokens: &mut Lexer) -> Result<NodeId, ParseError> {
         match tokens.try_next() {
             Ok(TokenType::LParem) => match tokens.peek_next_token() {
                 Ok((_, TokenType::Symbol(symbol))) => match SpecialForm::from_str(symbol.as_str()) {
                     Ok(form) => {
                         tokens.consume_symbol().unwrap();
-                        Ok(Node::Pair(
-                            Node::SpecialForm(form).into(),
-                            Self::parse_list(tokens)?.into(),
-                        ))
+                        let head = self.add(Node::SpecialForm(form));
+                        let rest = self.parse_list(tokens)?;
+                        Ok(self.pair(head, rest))
                     }
-                    Err(_) => Self::parse_list(tokens),
+                    Err(_) => self.parse_list(tokens),
                 },
-                _ => Self::parse_list(tokens),
+                _ => self.parse_list(tokens),
             },
             // '(...) is equivalent to (quote (...)).
-            Ok(TokenType::Quote) => Ok(Node::Pair(
-                Node::SpecialForm(SpecialForm::Quote).into(),
-                Node::Pair(Self::parse(tokens)?.into(), nil!().into()).into(),
-            )),
-            Ok(TokenType::Number(i)) => Ok(Node::Number(i)),
+            Ok(TokenType::Quote) => {
+                let inner = self.parse(tokens)?;
+                let nil = self.nil();
+                let rest = self.pair(inner, nil);
+                let head = self.add(Node::SpecialForm(SpecialForm::Quote));
+                Ok(self.pair(head, rest))
+            }
+            Ok(TokenType::Number(i)) => Ok(self.add(Node::Number(i))),
             // If a special form appears here, it will become a symbol that
             // has the same name as the special form. This is what the user
             // wants when creating a metacircular interpreter.
-            Ok(TokenType::Symbol(symbol)) => Ok(Node::Symbol(symbol.into())),
-            Ok(TokenType::String(value)) => Ok(Node::String(value)),
+            Ok(TokenType::Symbol(symbol)) => Ok(self.add(Node::Symbol(symbol.into()))),
+            Ok(TokenType::String(value)) => Ok(self.add(Node::String(value))),
             Ok(TokenType::RParem) => Err(ParseError::SyntaxError(format!(
                 "At position {}: Unexpected \")\"",
                 tokens.get_cur_pos()
@@ -1,11 +1,10 @@
 //! The preprocessor module.
 
-use std::{cell::RefCell, collections::HashMap, rc::Rc};
+use std::collections::HashMap;
 
 use crate::{
-    nil,
-    node::{Node, Pattern, pattern_matching},
-    symbol::{SpecialForm, Symbol},
+    node::{Ast, Node, NodeId, Pattern, pattern_matching},
+    symbol::{SpecialForm, Symbol, atom_name},
     util::vectorize,
 };
 
@@ -15,128 +14,95 @@ use crate::{
 /// 1. Expanding macros
 /// 2. Syntax desugaring (e.g. `cond` -> `if`)
 pub trait PreProcess {
-    fn preprocess(&mut self, macros: &mut HashMap<String, Macro>) -> Result<Self, String>
-    where
-        Self: Sized;
+    fn preprocess(
+        &mut self,
+        node: NodeId,
+        macros: &mut HashMap<String, Macro>,
+    ) -> Result<NodeId, String>;
 }
 
-/// Generate a list node from a vector of nodes.
+/// Generate a list node in `$ast` from the given elements.
 #[macro_export]
 macro_rules! vec_to_list {
-    ($e:expr) => {
-        Node::Pair($e, nil!().into())
-    };
-    ($e:expr, $($rest:tt)*) => {
-        Node::Pair($e, vec_to_list!($($rest)*).into())
-    };
+    ($ast:expr $(, $e:expr)* $(,)?) => {{
+        let elems = vec![$($e),*];
+        $ast.list(elems)
+    }};
 }
 
 /// Process a list of expression to evaluate, such as the function body of
 /// `lambda`.
 macro_rules! body {
-    ($node: expr) => {
-        Node::Pair(Node::SpecialForm(SpecialForm::Begin).into(), $node)
-    };
+    ($ast:expr, $node:expr) => {{
+        let begin = $ast.add(Node::SpecialForm(SpecialForm::Begin));
+        $ast.pair(begin, $node)
+    }};
 }
 
 /// Macros.
 /// The fields are:
 /// - Pattern
-/// - Template (represented by a node)
+/// - Template (an id into the arena the macro was defined in)
 pub struct Macro {
     pattern: Pattern,
-    template: Rc<RefCell<Node>>,
+    template: NodeId,
 }
 
 impl Macro {
-    fn new(pattern: Pattern, template: Rc<RefCell<Node>>) -> Self {
+    fn new(pattern: Pattern, template: NodeId) -> Self {
         Macro { pattern, template }
     }
 }
 
-impl Node {
-    pub fn deep_copy(&self) -> Node {
-        match self {
-            Node::Number(num) => Node::Number(num.clone()),
-            Node::Symbol(sym) => Node::Symbol(sym.clone()),
-            Node::String(val) => Node::String(val.clone()),
-            Node::Pair(car, cdr) => Node::Pair(
-                car.borrow().deep_copy().into(),
-                cdr.borrow().deep_copy().into(),
-            ),
-            Node::SpecialForm(form) => Node::SpecialForm(form.clone()),
-        }
-    }
-
-    pub fn replace(&mut self, src: &Node, dst: &Node) {
-        if *self == *src {
-            *self = dst.clone();
-            return;
-        }
-        match self {
-            Node::Number(_) | Node::Symbol(_) | Node::SpecialForm(_) | Node::String(_) => {
-                // do nothing
-            }
-            Node::Pair(car, cdr) => {
-                car.borrow_mut().replace(src, dst);
-                cdr.borrow_mut().replace(src, dst);
-            }
-        }
-    }
-}
-
-impl PreProcess for Node {
-    fn preprocess(&mut self, macros: &mut HashMap<String, Macro>) -> Result<Node, String> {
-        match self {
-            Node::Number(_) | Node::Symbol(_) | Node::SpecialForm(_) | Node::String(_) => {
-                Ok(self.deep_copy())
-            }
-            Node::Pair(car, cdr) => {
-                let car = car.borrow_mut().preprocess(macros)?;
+impl PreProcess for Ast {
+    fn preprocess(
+        &mut self,
+        node: NodeId,
+        macros: &mut HashMap<String, Macro>,
+    ) -> Result<NodeId, String> {
+        match *self.get(node) {
+            Node::Number(_) | Node::Symbol(_) | Node::SpecialForm(_) | Node::String(_) => Ok(node),
+            Node::Pair(old_car, old_cdr) => {
+                let car = self.preprocess(old_car, macros)?;
                 // skip preprocessing if this expression is quoted
-                if car == Node::SpecialForm(SpecialForm::Quote) {
-                    return Ok(Node::Pair(car.into(), cdr.clone()));
+                if matches!(self.get(car), Node::SpecialForm(SpecialForm::Quote)) {
+                    return Ok(node);
                 }
-                let cdr = cdr.borrow_mut().preprocess(macros)?;
-                match &car {
-                    Node::Symbol(Symbol::User(sym)) if macros.contains_key(sym) => {
-                        let Macro { pattern, template } = macros.get(sym).unwrap();
+                let cdr = self.preprocess(old_cdr, macros)?;
+                match self.get(car).clone() {
+                    Node::Symbol(Symbol::User(sym)) if macros.contains_key(atom_name(sym)) => {
+                        let Macro { pattern, template } = macros.get(atom_name(sym)).unwrap();
+                        let pattern = pattern.clone();
+                        let template = *template;
                         let mut bindings = HashMap::new();
-                        let params = vectorize(cdr.into())?;
-                        pattern_matching(pattern, &params, &mut bindings)?;
+                        let params = vectorize(self, cdr)?;
+                        pattern_matching(self, &pattern, &params, &mut bindings)?;
 
-                        let mut body = template.borrow().deep_copy();
-                        for (name, param) in bindings {
-                            body.replace(&Node::Symbol(Symbol::User(name)), &param.borrow());
-                        }
-                        Ok(body)
+                        // Substitution is copy-on-write, so the template
+                        // stays pristine and each use shares its unchanged
+                        // subtrees with it.
+                        Ok(self.substitute(template, &bindings))
                     }
                     Node::SpecialForm(SpecialForm::DefineSyntaxRule) => {
-                        let (sym, body) = cdr.as_pair()?;
-                        let (car, cdr) = sym.borrow().as_pair()?;
-                        let name = car.borrow().as_user_symbol()?;
-                        macros.insert(
-                            name,
-                            Macro::new(Pattern::try_from(cdr.clone())?, body!(body).into()),
-                        );
-                        Ok(nil!())
+                        let (sym, body) = self.as_pair(cdr)?;
+                        let (head, rest) = self.as_pair(sym)?;
+                        let name = self.as_user_symbol(head)?;
+                        let template = body!(self, body);
+                        macros.insert(name, Macro::new(self.pattern(rest)?, template));
+                        Ok(self.nil())
                     }
                     Node::SpecialForm(SpecialForm::Define) => {
                         // `(define (f ...) ...)` -> `(define f (lambda (...) ...))`
-                        let (pattern, body) = cdr.as_pair()?;
-                        if let Node::Pair(func, params) = &*pattern.borrow() {
-                            let ret = vec_to_list!(
-                                car.into(),
-                                func.clone(),
-                                Node::Pair(
-                                    Node::SpecialForm(SpecialForm::Lambda).into(),
-                                    Node::Pair(params.clone(), body).into()
-                                )
-                                .into()
-                            );
-                            Ok(ret)
+                        let (pattern, body) = self.as_pair(cdr)?;
+                        if let Node::Pair(func, params) = *self.get(pattern) {
+                            let head = self.add(Node::SpecialForm(SpecialForm::Lambda));
+                            let rest = self.pair(params, body);
+                            let lambda = self.pair(head, rest);
+                            Ok(vec_to_list!(self, car, func, lambda))
+                        } else if car == old_car && cdr == old_cdr {
+                            Ok(node)
                         } else {
-                            Ok(Node::Pair(car.into(), cdr.into()))
+                            Ok(self.pair(car, cdr))
                         }
                     }
                     Node::SpecialForm(SpecialForm::Cond) => {
@@ -146,17 +112,13 @@ impl PreProcess for Node {
                         //        (if c2
                         //            (begin v2)
                         //            ...))
-                        let params = vectorize(cdr.into())?;
-                        let mut body = nil!();
+                        let params = vectorize(self, cdr)?;
+                        let mut body = self.nil();
                         for node in params.iter().rev() {
-                            let (cond, value) = node.borrow().as_pair()?;
-                            body = vec_to_list!(
-                                Node::SpecialForm(SpecialForm::If).into(),
-                                cond,
-                                Node::Pair(Node::SpecialForm(SpecialForm::Begin).into(), value)
-                                    .into(),
-                                body.into()
-                            );
+                            let (cond, value) = self.as_pair(*node)?;
+                            let value = body!(self, value);
+                            let head = self.add(Node::SpecialForm(SpecialForm::If));
+                            body = vec_to_list!(self, head, cond, value, body);
                         }
                         Ok(body)
                     }
@@ -170,34 +132,18 @@ impl PreProcess for Node {
                         //              (if (eq? xn nil)
                         //                  xn
                         //                  xn)...))
-                        let params = vectorize(cdr.into())?;
+                        let params = vectorize(self, cdr)?;
                         if params.is_empty() {
-                            Ok(Node::Symbol(Symbol::T))
+                            Ok(self.add(Node::Symbol(Symbol::T)))
                         } else {
-                            let value = params.last().unwrap();
-                            let mut body = vec_to_list!(
-                                Node::SpecialForm(SpecialForm::If).into(),
-                                vec_to_list!(
-                                    Node::Symbol(Symbol::Eq).into(),
-                                    value.clone(),
-                                    nil!().into()
-                                )
-                                .into(),
-                                value.clone(),
-                                value.clone()
-                            );
-                            for value in params.iter().rev().skip(1) {
-                                body = vec_to_list!(
-                                    Node::SpecialForm(SpecialForm::If).into(),
-                                    vec_to_list!(
-                                        Node::Symbol(Symbol::Eq).into(),
-                                        value.clone(),
-                                        nil!().into()
-                                    )
-                                    .into(),
-                                    value.clone(),
-                                    body.into()
-                                );
+                            let mut body = *params.last().unwrap();
+                            for value in params.iter().rev() {
+                                let value = *value;
+                                let eq = self.add(Node::Symbol(Symbol::Eq));
+                                let nil = self.nil();
+                                let cond = vec_to_list!(self, eq, value, nil);
+                                let head = self.add(Node::SpecialForm(SpecialForm::If));
+                                body = vec_to_list!(self, head, cond, value, body);
                             }
                             Ok(body)
                         }
@@ -212,43 +158,37 @@ impl PreProcess for Node {
                         //              (if xn
                         //                  xn
                         //                  nil)...))
-                        let params = vectorize(cdr.into())?;
-                        let mut body = nil!();
+                        let params = vectorize(self, cdr)?;
+                        let mut body = self.nil();
                         for param in params.iter().rev() {
-                            body = vec_to_list!(
-                                Node::SpecialForm(SpecialForm::If).into(),
-                                param.clone(),
-                                param.clone(),
-                                body.into()
-                            )
+                            let head = self.add(Node::SpecialForm(SpecialForm::If));
+                            body = vec_to_list!(self, head, *param, *param, body);
                         }
                         Ok(body)
                     }
                     Node::SpecialForm(SpecialForm::Let) => {
                         // (let ((x1 e11) (x2 e12) ...) e21 e22 ...)
                         // -> ((lambda (x1 x2 ...) e21 e22 ...) e11 e12 ...)
-                        let (bindings, body) = cdr.as_pair()?;
+                        let (bindings, body) = self.as_pair(cdr)?;
                         let mut keys = vec![];
                         let mut values = vec![];
-                        for binding in vectorize(bindings)? {
-                            let (k, v) = binding.borrow().as_pair()?;
+                        for binding in vectorize(self, bindings)? {
+                            let (k, v) = self.as_pair(binding)?;
                             keys.push(k);
-                            let (car, _) = v.borrow().as_pair()?;
-                            values.push(car);
+                            let (value, _) = self.as_pair(v)?;
+                            values.push(value);
                         }
-                        let keys_node = Node::from_iter(keys);
-                        let values_node = Node::from_iter(values);
-                        let ret = Node::Pair(
-                            Node::Pair(
-                                Node::SpecialForm(SpecialForm::Lambda).into(),
-                                Node::Pair(keys_node.into(), body).into(),
-                            )
-                            .into(),
-                            values_node.into(),
-                        );
-                        Ok(ret)
+                        let keys_node = self.list(keys);
+                        let values_node = self.list(values);
+                        let head = self.add(Node::SpecialForm(SpecialForm::Lambda));
+                        let rest = self.pair(keys_node, body);
+                        let lambda = self.pair(head, rest);
+                        Ok(self.pair(lambda, values_node))
                     }
-                    _ => Ok(Node::Pair(car.into(), cdr.into())),
+                    // No rewrite applies: keep the original node when the
+                    // children came back unchanged.
+                    _ if car == old_car && cdr == old_cdr => Ok(node),
+                    _ => Ok(self.pair(car, cdr)),
                 }
             }
         }
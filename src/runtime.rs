@@ -1,7 +1,13 @@
 //! The runtime module.
 
 use std::{
-    cell::RefCell, collections::HashMap, fmt::Display, mem::swap, rc::Rc, result::Result, vec::Vec,
+    collections::{HashMap, HashSet},
+    fmt::Display,
+    mem::{self, swap},
+    result::Result,
+    sync::atomic::{AtomicUsize, Ordering},
+    time::{Duration, Instant},
+    vec::Vec,
 };
 
 use crate::{
@@ -9,8 +15,8 @@ use crate::{
     error::{ParseError, RuntimeError},
     lexer::{Lexer, Number, TokenType},
     logger::{log_debug, log_error},
-    node::Node,
-    symbol::Symbol,
+    node::{Ast, Node, NodeId},
+    symbol::{AtomId, Symbol, intern},
     util::{CVoidFunc, eval_arith, eval_rel, map_to_assoc_lst},
 };
 
@@ -41,6 +47,10 @@ pub struct Closure {
     /// Whether the closure is variadic. If it is `true`, then the last argument
     /// of the closure is the list of remaining arguments.
     pub(crate) variadic: bool,
+    /// Whether the closure's call environment can outlive the call, i.e.
+    /// the body creates a closure that captures it. When `false` the frame
+    /// is allocated on [Runtime::frames] instead of the GC heap.
+    pub(crate) escapes: bool,
 }
 
 impl PartialEq for Closure {
@@ -55,6 +65,7 @@ impl Closure {
         body: CVoidFunc,
         nargs: usize,
         variadic: bool,
+        escapes: bool,
         runtime: &Runtime,
     ) -> Closure {
         Closure {
@@ -63,13 +74,14 @@ impl Closure {
             env: runtime.current_env(),
             nargs,
             variadic,
+            escapes,
         }
     }
 }
 
 // Environment manipulation.
-impl Env<String, usize, Runtime> for usize {
-    fn get_cur(&self, key: &String, runtime: &Runtime) -> Option<usize> {
+impl Env<str, usize, Runtime> for usize {
+    fn get_cur(&self, key: &str, runtime: &Runtime) -> Option<usize> {
         runtime.get_cur_env(*self, key)
     }
     fn do_in_outer<Out, F>(&self, func: F, runtime: &Runtime) -> Out
@@ -93,13 +105,18 @@ impl Env<String, usize, Runtime> for usize {
     fn has_outer(&self, runtime: &Runtime) -> bool {
         runtime.get_outer_env(*self).is_some()
     }
-    fn insert_cur(&mut self, key: &String, value: usize, runtime: &mut Runtime) {
+    fn insert_cur(&mut self, key: &str, value: usize, runtime: &mut Runtime) {
         runtime.insert_cur_env(*self, key, value);
     }
 }
 
 /// The runtime data node. A runtime data node is owned by the garbage
 /// collector and is used by the user to store data structures at run-time.
+///
+/// Every variant fits in a tag and two words. The GC areas are vectors of
+/// nodes, each sized by the largest variant, so keeping the variable-sized
+/// environment and closure payloads out of line (see [EnvPayload]) packs
+/// more pairs per cache line and makes a copy a fixed small move.
 #[derive(Debug, Clone)]
 pub enum RuntimeNode {
     /// Symbols.
@@ -108,15 +125,116 @@ pub enum RuntimeNode {
     Number(Number),
     /// Pair of nodes.
     Pair(usize, usize),
-    /// Environments.
-    /// Fields are: (Name, Variable map, Outer environment)
-    Environment(String, HashMap<String, usize>, Option<usize>),
-    /// Closures.
-    Closure(Closure),
+    /// Environments. The payload lives in [Runtime::env_payloads] at this
+    /// index.
+    Environment(usize),
+    /// Closures. The payload lives in [Runtime::closure_payloads] at this
+    /// index.
+    Closure(usize),
     /// Indicates the data is moved to the [data field] position of the other area.
     BrokenHeart(usize),
 }
 
+/// The out-of-line payload of a [RuntimeNode::Environment]: its name,
+/// variable map, argument slots and outer environment.
+///
+/// The argument slots mirror the positional parameters (`#0_func_{id}`,
+/// `#1_func_{id}`, ...) stored in the variable map, so the compiler can
+/// address them by `(depth, slot)` without hashing the name.
+///
+/// Each payload is owned by exactly one node (or frame-stack entry): the
+/// collectors move the slim node and leave the payload in place, and a full
+/// collection compacts the table, dropping the payloads of dead
+/// environments.
+#[derive(Debug, Default, Clone, PartialEq)]
+pub(crate) struct EnvPayload {
+    pub(crate) name: String,
+    pub(crate) map: HashMap<String, usize>,
+    pub(crate) args: Vec<usize>,
+    pub(crate) outer: Option<usize>,
+}
+
+/// Tag bit marking a node reference as an immediate fixnum.
+///
+/// Node references are `usize` indices into the GC area, which never come
+/// close to using the top bit. When the bit is set, the low 63 bits hold a
+/// signed integer value: small integers live directly in the reference, so
+/// integer temporaries allocate no node and never trigger GC.
+pub const FIXNUM_TAG: usize = 1 << (usize::BITS - 1);
+
+/// Encode an integer as an immediate fixnum reference, or `None` if it does
+/// not fit in the payload bits.
+pub fn fixnum_to_index(value: i64) -> Option<usize> {
+    if (-(1 << 62)..(1 << 62)).contains(&value) {
+        Some((value as usize & !FIXNUM_TAG) | FIXNUM_TAG)
+    } else {
+        None
+    }
+}
+
+/// Decode an immediate fixnum reference, or `None` if the reference points
+/// into the GC area.
+pub fn index_to_fixnum(index: usize) -> Option<i64> {
+    if index & FIXNUM_TAG != 0 {
+        // Sign-extend the 63 payload bits.
+        Some(((index << 1) as i64) >> 1)
+    } else {
+        None
+    }
+}
+
+/// Tag bit marking a node reference as living in the nursery.
+///
+/// Fresh allocations go to the nursery; a minor collection evacuates the
+/// survivors into the main area, so short-lived pairs die without the
+/// collector ever re-copying the stable main-area structures.
+pub const NURSERY_BASE: usize = 1 << (usize::BITS - 2);
+
+/// Whether a reference points into the nursery.
+fn is_nursery_ref(index: usize) -> bool {
+    index & FIXNUM_TAG == 0 && index & NURSERY_BASE != 0
+}
+
+/// Tag bit marking a node reference as living on the frame stack.
+///
+/// Call frames the compiler proves no closure captures go to
+/// [Runtime::frames] instead of the GC heap: they are popped when the call
+/// returns and the collectors scan them as roots without ever copying them.
+pub const FRAME_BASE: usize = 1 << (usize::BITS - 3);
+
+/// Whether a reference points into the frame stack.
+fn is_frame_ref(index: usize) -> bool {
+    index & (FIXNUM_TAG | NURSERY_BASE) == 0 && index & FRAME_BASE != 0
+}
+
+/// Register holding the closure being applied.
+pub const REG_CLOSURE: usize = 0;
+/// Number of runtime registers.
+pub const NUM_REGS: usize = 1;
+
+/// Value of a register that holds no node reference. It is a fixnum, so the
+/// GC never follows it.
+const REG_EMPTY: usize = FIXNUM_TAG;
+
+/// Process-wide handle allocators for the constant pool and the debug-info
+/// table. A unit's pooling site allocates its handle the first time it runs
+/// in any context and keeps it in a per-module static, so the handle stays
+/// meaningful no matter which context executes the unit; each context then
+/// materializes its own entry under that handle (see
+/// [Runtime::set_constant] and [Runtime::add_dbg_info]).
+static NEXT_CONSTANT_HANDLE: AtomicUsize = AtomicUsize::new(0);
+static NEXT_DBG_HANDLE: AtomicUsize = AtomicUsize::new(0);
+
+/// Allocate a fresh process-wide constant-pool handle.
+pub fn alloc_constant_handle() -> usize {
+    NEXT_CONSTANT_HANDLE.fetch_add(1, Ordering::Relaxed)
+}
+
+/// Allocate a fresh process-wide debug-info handle.
+pub fn alloc_dbg_handle() -> usize {
+    NEXT_DBG_HANDLE.fetch_add(1, Ordering::Relaxed)
+}
+
 /// Whether the runtime should enter the debugger.
 #[derive(Debug, PartialEq, PartialOrd, Clone, Copy)]
 pub enum DbgState {
@@ -130,6 +248,51 @@ pub enum DbgState {
 
 type StaticFn = Box<dyn Fn(&Runtime) -> DbgState + Sync + Send + 'static>;
 
+/// Statistics updated by the collectors.
+///
+/// Exposed through [Runtime::gc_stats], `rt_gc_stats` and the debugger's
+/// `gc` command, so heap behaviour can be observed without a profiler.
+#[derive(Debug, Default, Clone, Copy)]
+pub struct GcStats {
+    /// Number of minor collections.
+    pub minor_collections: usize,
+    /// Number of full collections.
+    pub full_collections: usize,
+    /// Total time spent in the collectors.
+    pub total_pause: Duration,
+    /// Longest single collection.
+    pub max_pause: Duration,
+    /// Nodes ever allocated.
+    pub allocated_nodes: usize,
+    /// Nodes copied out of the nursery by minor collections.
+    pub promoted_nodes: usize,
+    /// Nodes in the main area after the last full collection.
+    pub live_nodes: usize,
+    /// Times the GC area size was doubled.
+    pub area_growths: usize,
+}
+
+impl Display for GcStats {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        writeln!(
+            f,
+            "collections: {} minor, {} full",
+            self.minor_collections, self.full_collections
+        )?;
+        writeln!(
+            f,
+            "pause: {:?} total, {:?} max",
+            self.total_pause, self.max_pause
+        )?;
+        writeln!(
+            f,
+            "nodes: {} allocated, {} promoted, {} live after last full collection",
+            self.allocated_nodes, self.promoted_nodes, self.live_nodes
+        )?;
+        write!(f, "area growths: {}", self.area_growths)
+    }
+}
+
 /// The runtime.
 ///
 /// To simplify bindings and avoid ownership issues, users can only get the
@@ -145,12 +308,60 @@ pub struct Runtime {
     /// The GC area is split into two halves.
     /// The first one is always the one being used.
     areas: (Vec<RuntimeNode>, Vec<RuntimeNode>),
-    /// Size of the GC area in pairs.                            
+    /// The nursery generation. Fresh allocations go here and are referenced
+    /// with [NURSERY_BASE]-tagged indices; minor collections evacuate the
+    /// survivors into the main area.
+    nursery: Vec<RuntimeNode>,
+    /// Main-area nodes that were mutated to point into the nursery.
+    /// They are extra roots for minor collections.
+    remembered: HashSet<usize>,
+    /// Size of the GC area in pairs.
     size: usize,
+    /// Factor the GC area grows by when a collection reclaims nothing.
+    growth_factor: usize,
     /// Root variables that won't be GCed.
     ///
     /// The key is its name and the value is its index.
     roots: HashMap<String, usize>,
+    /// Runtime registers. Like [Runtime::roots] they are GC roots, but they
+    /// are addressed by index so compiled code can thread values (the
+    /// closure being applied, the caller's environment) through them without
+    /// hashing a string key per application.
+    registers: [usize; NUM_REGS],
+    /// Constant pool, indexed by the process-wide handles of
+    /// [alloc_constant_handle]. Each context parses its own copy of a
+    /// quoted literal under the pooling site's handle (see
+    /// [Runtime::set_constant]); slots of units this context never ran
+    /// hold [REG_EMPTY], which the collectors pass through like an empty
+    /// register. The entries are GC roots.
+    constants: Vec<usize>,
+    /// Top-level variables, indexed by atom id.
+    ///
+    /// Globals live in this flat table instead of the top environment's
+    /// map, so a lookup is an array access and the collectors scan one
+    /// root vector instead of re-building a hash map of every global on
+    /// each collection.
+    globals: Vec<Option<usize>>,
+    /// The frame stack. Call frames of closures whose environment provably
+    /// never escapes (see [Closure::escapes]) live here, referenced with
+    /// [FRAME_BASE]-tagged indices. They are popped when the call returns
+    /// and scanned as roots by the collectors, never copied.
+    frames: Vec<RuntimeNode>,
+    /// Saved caller environments, paired with the frame-stack watermark at
+    /// call time. [Runtime::restore_env] pops an entry, truncates the frame
+    /// stack to the watermark and moves back to the environment.
+    env_stack: Vec<(usize, usize)>,
+    /// Closure invocation counters, indexed by the numeric closure name the
+    /// compiler assigns (`func_{id}` in the generated C). Bumped with a
+    /// plain array increment in [Runtime::prepare_args], so the profile is
+    /// cheap enough to stay on in production.
+    closure_calls: Vec<usize>,
+    /// Pending tail call. A call in tail position stores the callee here and
+    /// returns; the nearest enclosing driver loop keeps bouncing until no
+    /// call is pending, so self-recursive loops run in constant C stack.
+    pending_call: Option<CVoidFunc>,
+    /// Collector statistics; see [GcStats].
+    gc_stats: GcStats,
     /// Opened packages.
     ///
     /// This field is not used, but we need to keep it so that we can use the
@@ -158,6 +369,27 @@ pub struct Runtime {
     packages: HashMap<String, Library>,
     /// Callback function called when a breakpoint is hit.
     dbg_callback: Option<StaticFn>,
+    /// Output buffer reused by [Runtime::display_node_buf], so repeated
+    /// `display` calls neither allocate a fresh string nor leak it to C.
+    display_buf: String,
+    /// Expression texts for debug information, indexed by the
+    /// process-wide handles of [alloc_dbg_handle]. Compiled units register
+    /// their texts at startup and evaluation sites pass the handle, so
+    /// the text is only touched when the debugger actually fires. Slots
+    /// of units this context never ran stay empty.
+    dbg_texts: Vec<String>,
+    /// Names of the top-level JIT units executed so far, in execution
+    /// order. `save_image` (in [crate::package]) writes this list as a heap
+    /// image; replaying it from the binary cache reproduces the runtime
+    /// state without touching the C toolchain.
+    jit_log: Vec<String>,
+    /// Out-of-line environment payloads, indexed by the slim
+    /// [RuntimeNode::Environment] nodes; compacted by full collections.
+    env_payloads: Vec<EnvPayload>,
+    /// Out-of-line closure payloads, indexed by the slim
+    /// [RuntimeNode::Closure] nodes; owned and compacted like
+    /// [Runtime::env_payloads].
+    closure_payloads: Vec<Closure>,
 }
 
 impl Display for Runtime {
@@ -167,6 +399,11 @@ impl Display for Runtime {
             write!(f, "{} ", self.display_node_idx(node))?;
         }
         writeln!(f, "]")?;
+        write!(f, "nursery: [")?;
+        for slot in 0..self.nursery.len() {
+            write!(f, "{} ", self.display_node_idx(NURSERY_BASE | slot))?;
+        }
+        writeln!(f, "]")?;
         write!(f, "stack: [")?;
         for node in self.stack.clone() {
             write!(f, "{} ", self.display_node_idx(node))?;
@@ -194,6 +431,13 @@ pub trait LoadToRuntime {
 
 impl LoadToRuntime for Number {
     fn load_to(self, runtime: &mut Runtime) -> Result<(), ParseError> {
+        // Small integers are pushed as immediate fixnums and allocate nothing.
+        if let Number::Int(value) = self {
+            if let Some(index) = fixnum_to_index(value) {
+                runtime.push(index);
+                return Ok(());
+            }
+        }
         RuntimeNode::Number(self).load_to(runtime)
     }
 }
@@ -206,7 +450,8 @@ impl LoadToRuntime for Symbol {
 
 impl LoadToRuntime for Closure {
     fn load_to(self, runtime: &mut Runtime) -> Result<(), ParseError> {
-        RuntimeNode::Closure(self).load_to(runtime)
+        let payload = runtime.add_closure_payload(self);
+        RuntimeNode::Closure(payload).load_to(runtime)
     }
 }
 
@@ -216,99 +461,190 @@ impl LoadToRuntime for &str {
     }
 }
 
-/// Pop the stack for `n` times if `stmt` returns error.
-/// It is used to remove previous objects from the stack, not the object being
-/// loaded to the stack (which will be taken care of by `load_to`).
-macro_rules! pop_on_err {
-    ($stmt:expr, $runtime:expr, $n: expr) => {
-        $stmt.map_err(|e| {
-            for _ in 0..$n {
-                $runtime.pop();
-            }
-            e
-        })?
-    };
-}
-
 impl LoadToRuntime for &mut Lexer {
     fn load_to(self, runtime: &mut Runtime) -> Result<(), ParseError> {
-        match self.try_next() {
-            Ok(TokenType::LParem) => parse_list(self, runtime),
-            Ok(TokenType::Quote) => {
-                Symbol::Nil.load_to(runtime)?;
-                pop_on_err!(self.load_to(runtime), runtime, 1);
-                runtime.new_pair();
-                pop_on_err!(
-                    Symbol::User("quote".to_string()).load_to(runtime),
-                    runtime,
-                    1
-                );
-                runtime.new_pair();
-                Ok(())
-            }
-            Ok(TokenType::Number(i)) => i.load_to(runtime),
-            Ok(TokenType::String(str)) => {
-                Symbol::Nil.load_to(runtime)?;
-                pop_on_err!(Symbol::from(str).load_to(runtime), runtime, 1);
-                runtime.new_pair();
-                pop_on_err!(
-                    Symbol::User("quote".to_string()).load_to(runtime),
-                    runtime,
-                    1
-                );
-                runtime.new_pair();
-                Ok(())
-            }
-            Ok(TokenType::Symbol(symbol)) => Symbol::from(symbol).load_to(runtime),
-            Ok(TokenType::RParem) => Err(ParseError::SyntaxError(format!(
-                "At position {}: Unexpected ')'",
-                self.get_cur_pos()
-            ))),
-            Ok(TokenType::Dot) => Err(ParseError::SyntaxError(format!(
-                "At position {}: Unexpected '.'",
-                self.get_cur_pos()
-            ))),
-            Err(e) => Err(e),
-        }
+        load_streaming(self, runtime, &mut || None)
     }
 }
 
-/// The same as [Node::parse_list], except that it deals with the runtime and
-/// loads everything into the stack.
+/// A frame of the explicit parser stack in [load_streaming]: either a list
+/// under construction (its parsed elements sit on the runtime stack), or a
+/// pending `'` waiting to wrap the next expression.
+enum ParseFrame {
+    /// `count` elements parsed so far; `dot` records the element count at
+    /// the point the `.` was seen, if any.
+    List { count: usize, dot: Option<usize> },
+    Quote,
+}
+
+/// Parse one expression from `tokens` and load it onto the runtime stack,
+/// driving an explicit frame stack instead of recursing, so list length and
+/// nesting depth are bounded by the heap rather than the Rust call stack.
+///
+/// When the token stream runs dry, `refill` is asked for more input, which
+/// is appended to the lexer; parsing resumes where it stopped, so multi-line
+/// input is consumed in a single pass. A `refill` returning [None] surfaces
+/// [ParseError::EOF].
 ///
 /// # Errors
 ///
 /// Returns [ParseError] and restores the stack to the state before the
 /// function call if an error occurs.
-fn parse_list(tokens: &mut Lexer, runtime: &mut Runtime) -> Result<(), ParseError> {
-    macro_rules! consume {
-        ($tokens:expr, $ty:expr) => {
-            $tokens.consume($ty)
+pub fn load_streaming(
+    tokens: &mut Lexer,
+    runtime: &mut Runtime,
+    refill: &mut dyn FnMut() -> Option<String>,
+) -> Result<(), ParseError> {
+    let mut frames: Vec<ParseFrame> = vec![];
+
+    // Elements of unfinished lists live on the runtime stack (which keeps
+    // them rooted across GC); pop them before surfacing an error.
+    macro_rules! fail {
+        ($frames:expr, $err:expr) => {{
+            let pushed: usize = $frames
+                .iter()
+                .map(|frame| match frame {
+                    ParseFrame::List { count, .. } => *count,
+                    ParseFrame::Quote => 0,
+                })
+                .sum();
+            for _ in 0..pushed {
+                runtime.pop();
+            }
+            return Err($err);
+        }};
+    }
+
+    loop {
+        let token = loop {
+            match tokens.try_next() {
+                Ok(token) => break token,
+                Err(ParseError::EOF) => match refill() {
+                    Some(more) => tokens.append(&more),
+                    None => fail!(frames, ParseError::EOF),
+                },
+                Err(e) => fail!(frames, e),
+            }
         };
-    }
-    match tokens.peek_next_token() {
-        Ok((_, TokenType::RParem)) => {
-            // case 1
-            consume!(tokens, TokenType::RParem)?;
-            Symbol::Nil.load_to(runtime)
-        }
-        _ => {
-            tokens.load_to(runtime)?; // car
-
-            // cdr
-            if let Ok((_, TokenType::Dot)) = tokens.peek_next_token() {
-                // case 3
-                pop_on_err!(consume!(tokens, TokenType::Dot), runtime, 1); // pop car
-                pop_on_err!(tokens.load_to(runtime), runtime, 1);
-                pop_on_err!(consume!(tokens, TokenType::RParem), runtime, 2); // pop both
-            } else {
-                // case 2
-                pop_on_err!(parse_list(tokens, runtime), runtime, 1); // pop car
-            };
 
-            runtime.swap();
-            runtime.new_pair();
-            Ok(())
+        let completed = match token {
+            TokenType::LParem => {
+                frames.push(ParseFrame::List { count: 0, dot: None });
+                false
+            }
+            TokenType::Quote => {
+                frames.push(ParseFrame::Quote);
+                false
+            }
+            TokenType::Number(i) => {
+                i.load_to(runtime).unwrap();
+                true
+            }
+            TokenType::Symbol(symbol) => {
+                Symbol::from(symbol).load_to(runtime).unwrap();
+                true
+            }
+            TokenType::String(str) => {
+                // A string literal loads as a quoted symbol.
+                Symbol::Nil.load_to(runtime).unwrap();
+                Symbol::from(str).load_to(runtime).unwrap();
+                runtime.new_pair();
+                Symbol::User(intern("quote")).load_to(runtime).unwrap();
+                runtime.new_pair();
+                true
+            }
+            TokenType::RParem => match frames.pop() {
+                Some(ParseFrame::List { count, dot }) => {
+                    match dot {
+                        None => {
+                            // Fold the elements into a proper list.
+                            Symbol::Nil.load_to(runtime).unwrap();
+                            for _ in 0..count {
+                                runtime.swap();
+                                runtime.new_pair();
+                            }
+                        }
+                        Some(d) if count == d + 1 => {
+                            // The element after the dot is the tail.
+                            for _ in 0..count - 1 {
+                                runtime.swap();
+                                runtime.new_pair();
+                            }
+                        }
+                        Some(_) => {
+                            frames.push(ParseFrame::List { count, dot });
+                            fail!(
+                                frames,
+                                ParseError::SyntaxError(format!(
+                                    "At position {}: Expected one expression after '.'",
+                                    tokens.get_cur_pos()
+                                ))
+                            )
+                        }
+                    }
+                    true
+                }
+                _ => fail!(
+                    frames,
+                    ParseError::SyntaxError(format!(
+                        "At position {}: Unexpected ')'",
+                        tokens.get_cur_pos()
+                    ))
+                ),
+            },
+            TokenType::Dot => match frames.last_mut() {
+                Some(ParseFrame::List { count, dot }) if *count > 0 && dot.is_none() => {
+                    *dot = Some(*count);
+                    false
+                }
+                _ => fail!(
+                    frames,
+                    ParseError::SyntaxError(format!(
+                        "At position {}: Unexpected '.'",
+                        tokens.get_cur_pos()
+                    ))
+                ),
+            },
+        };
+
+        if completed {
+            // Reduce: wrap pending quotes around the finished expression,
+            // then either count it as an element of the enclosing list or
+            // return it.
+            loop {
+                let past_tail = match frames.last_mut() {
+                    None => return Ok(()),
+                    Some(ParseFrame::Quote) => {
+                        frames.pop();
+                        Symbol::Nil.load_to(runtime).unwrap();
+                        runtime.swap();
+                        runtime.new_pair();
+                        Symbol::User(intern("quote")).load_to(runtime).unwrap();
+                        runtime.new_pair();
+                        continue;
+                    }
+                    Some(ParseFrame::List { count, dot }) => {
+                        if matches!(dot, Some(d) if *count > *d) {
+                            true
+                        } else {
+                            *count += 1;
+                            false
+                        }
+                    }
+                };
+                if past_tail {
+                    // A second expression after the dotted tail.
+                    runtime.pop();
+                    fail!(
+                        frames,
+                        ParseError::SyntaxError(format!(
+                            "At position {}: Expected ')'",
+                            tokens.get_cur_pos()
+                        ))
+                    )
+                }
+                break;
+            }
         }
     }
 }
@@ -491,6 +827,19 @@ impl StackMachine<usize> for Runtime {
                 unary_op!(self, nargs, |num| { Number::Float(f64::from(num).cos()) })
             }
             Symbol::Eq => {
+                assert_eq!(nargs, 2);
+                let lhs = self.pop();
+                let rhs = self.pop();
+                load_to!(
+                    self,
+                    if self.node_id_eq(lhs, rhs) {
+                        Symbol::T
+                    } else {
+                        Symbol::Nil
+                    }
+                )
+            }
+            Symbol::Equal => {
                 assert_eq!(nargs, 2);
                 let lhs = self.pop();
                 let rhs = self.pop();
@@ -510,10 +859,12 @@ impl StackMachine<usize> for Runtime {
             Symbol::Le => rel_op!(self, nargs, <=),
             Symbol::Atom => {
                 assert_eq!(nargs, 1);
-                let val = self.pop_as_node();
+                // Peek the node in place: the check needs its shape, not a
+                // clone.
+                let index = self.pop();
                 load_to!(
                     self,
-                    if let RuntimeNode::Pair(_, _) = val {
+                    if let Some(RuntimeNode::Pair(_, _)) = self.get_node_or_fixnum(index) {
                         Symbol::Nil
                     } else {
                         Symbol::T
@@ -522,44 +873,29 @@ impl StackMachine<usize> for Runtime {
             }
             Symbol::Car => {
                 assert_eq!(nargs, 1);
-                let index = self.top();
-                let node_str = self.display_node_idx(index);
-                let val = self.pop_as_node();
-                if let RuntimeNode::Pair(car, _) = val {
-                    self.push(car);
-                    Ok(())
-                } else {
-                    Err(RuntimeError::new(format!("{node_str} is not a pair")))
-                }
+                self.car()
             }
             Symbol::Cdr => {
                 assert_eq!(nargs, 1);
-                let index = self.top();
-                let node_str = self.display_node_idx(index);
-                let val = self.pop_as_node();
-                if let RuntimeNode::Pair(_, cdr) = val {
-                    self.push(cdr);
-                    Ok(())
-                } else {
-                    Err(RuntimeError::new(format!("{node_str} is not a pair")))
-                }
+                self.cdr()
             }
             Symbol::Cons => {
                 self.new_pair();
                 Ok(())
             }
             Symbol::List => {
-                self.zip_stack_nodes(nargs);
+                self.new_list(nargs);
                 Ok(())
             }
             Symbol::Number => {
                 assert_eq!(nargs, 1);
+                // A fixnum reference is a number without being a node.
+                let index = self.pop();
                 load_to!(
                     self,
-                    if let RuntimeNode::Number(_) = self.pop_as_node() {
-                        Symbol::T
-                    } else {
-                        Symbol::Nil
+                    match self.get_node_or_fixnum(index) {
+                        None | Some(RuntimeNode::Number(_)) => Symbol::T,
+                        _ => Symbol::Nil,
                     }
                 )
             }
@@ -581,114 +917,296 @@ impl Runtime {
     pub fn get_package(&self, name: &str) -> &Library {
         self.packages.get(name).unwrap()
     }
+
+    /// Record one top-level execution of a JIT unit for `save_image`.
+    pub fn log_jit_unit(&mut self, name: &str) {
+        self.jit_log.push(name.to_string());
+    }
+
+    /// The logged top-level JIT unit executions, in order.
+    pub fn jit_log(&self) -> &[String] {
+        &self.jit_log
+    }
 }
 
 // Node creation and GC
 impl Runtime {
-    // GC and maintain the fields of `gc_area`.
+    /// Full collection: copy every live node (main area and nursery) into
+    /// the other half of the GC area with an iterative Cheney scan.
     pub fn gc(&mut self) {
-        let old_free = self.get_free();
+        let pause_start = Instant::now();
+        let old_total = self.get_free() + self.nursery.len();
         self.areas.1.clear();
 
-        // Move all roots elements.
+        // Evacuate all roots.
         for (name, root) in map_to_assoc_lst(&self.roots) {
-            let new_root = self.gc_dfs(root);
+            let new_root = self.evacuate(root);
             self.set_root(name, new_root);
         }
-        // Move all stack elements.
-        let new_stack = self.stack.clone();
-        self.stack.clear();
-        for elem in new_stack {
-            let new_elem = self.gc_dfs(elem);
-            self.stack.push(new_elem);
+        for i in 0..NUM_REGS {
+            let reg = self.registers[i];
+            self.registers[i] = self.evacuate(reg);
+        }
+        for i in 0..self.constants.len() {
+            let constant = self.constants[i];
+            self.constants[i] = self.evacuate(constant);
+        }
+        for i in 0..self.globals.len() {
+            if let Some(global) = self.globals[i] {
+                self.globals[i] = Some(self.evacuate(global));
+            }
+        }
+        // Evacuate all stack elements.
+        for i in 0..self.stack.len() {
+            let elem = self.stack[i];
+            self.stack[i] = self.evacuate(elem);
+        }
+        // Frames stay in place; only the references they hold move.
+        for i in 0..self.frames.len() {
+            let node = mem::replace(&mut self.frames[i], RuntimeNode::BrokenHeart(0));
+            let node = self.rewrite_refs(node, false);
+            self.frames[i] = node;
+        }
+        for i in 0..self.env_stack.len() {
+            let (env, watermark) = self.env_stack[i];
+            self.env_stack[i] = (self.evacuate(env), watermark);
+        }
+        // Breadth-first scan: every node behind the scan pointer only
+        // references to-space, so no recursion and no revisiting.
+        let mut scan = 0;
+        while scan < self.areas.1.len() {
+            let node = mem::replace(&mut self.areas.1[scan], RuntimeNode::BrokenHeart(0));
+            let node = self.rewrite_refs(node, false);
+            self.areas.1[scan] = node;
+            scan += 1;
         }
 
+        // Compact the payload side tables in lockstep with the copy: every
+        // surviving environment or closure (to-space or frame stack) moves
+        // its payload into a fresh table and re-indexes itself; the payloads
+        // of dead nodes are dropped. Each payload is owned by exactly one
+        // node, so a double take is a collector bug.
+        let mut old_envs: Vec<Option<EnvPayload>> = mem::take(&mut self.env_payloads)
+            .into_iter()
+            .map(Some)
+            .collect();
+        let mut old_closures: Vec<Option<Closure>> = mem::take(&mut self.closure_payloads)
+            .into_iter()
+            .map(Some)
+            .collect();
+        let mut env_payloads = vec![];
+        let mut closure_payloads = vec![];
+        for node in self.areas.1.iter_mut().chain(self.frames.iter_mut()) {
+            match node {
+                RuntimeNode::Environment(payload) => {
+                    env_payloads.push(old_envs[*payload].take().expect("payload owned twice"));
+                    *payload = env_payloads.len() - 1;
+                }
+                RuntimeNode::Closure(payload) => {
+                    closure_payloads
+                        .push(old_closures[*payload].take().expect("payload owned twice"));
+                    *payload = closure_payloads.len() - 1;
+                }
+                _ => {}
+            }
+        }
+        self.env_payloads = env_payloads;
+        self.closure_payloads = closure_payloads;
+
         swap::<Vec<RuntimeNode>>(self.areas.0.as_mut(), self.areas.1.as_mut());
-        if self.get_free() == old_free {
+        self.nursery.clear();
+        self.remembered.clear();
+        if self.get_free() == old_total {
             // GC doesn't reclaim any memory. Increase the area size.
-            self.size *= 2;
+            self.size *= self.growth_factor;
+            self.gc_stats.area_growths += 1;
+        }
+        self.gc_stats.full_collections += 1;
+        self.gc_stats.live_nodes = self.get_free();
+        self.record_pause(pause_start);
+    }
+
+    /// Minor collection: evacuate the live nursery nodes into the main area.
+    ///
+    /// The roots are the root table, the stack and the remembered main-area
+    /// nodes; the long-lived main area itself is not copied. Falls back to a
+    /// full collection when the main area cannot absorb the whole nursery.
+    fn minor_gc(&mut self) {
+        if self.size.saturating_sub(self.get_free()) < self.nursery.len() {
+            self.gc();
+            return;
+        }
+
+        let pause_start = Instant::now();
+        let scan_start = self.areas.0.len();
+        for (name, root) in map_to_assoc_lst(&self.roots) {
+            let new_root = self.evacuate_young(root);
+            self.set_root(name, new_root);
+        }
+        for i in 0..NUM_REGS {
+            let reg = self.registers[i];
+            self.registers[i] = self.evacuate_young(reg);
+        }
+        for i in 0..self.constants.len() {
+            let constant = self.constants[i];
+            self.constants[i] = self.evacuate_young(constant);
+        }
+        for i in 0..self.globals.len() {
+            if let Some(global) = self.globals[i] {
+                self.globals[i] = Some(self.evacuate_young(global));
+            }
+        }
+        for i in 0..self.stack.len() {
+            let elem = self.stack[i];
+            self.stack[i] = self.evacuate_young(elem);
+        }
+        for i in 0..self.frames.len() {
+            let node = mem::replace(&mut self.frames[i], RuntimeNode::BrokenHeart(0));
+            let node = self.rewrite_refs(node, true);
+            self.frames[i] = node;
         }
+        for i in 0..self.env_stack.len() {
+            let (env, watermark) = self.env_stack[i];
+            self.env_stack[i] = (self.evacuate_young(env), watermark);
+        }
+        // Old nodes mutated to point at the nursery stand in for the main
+        // area we are not scanning. Once rewritten they are old-to-old again.
+        let remembered: Vec<usize> = self.remembered.drain().collect();
+        for index in remembered {
+            let node = mem::replace(&mut self.areas.0[index], RuntimeNode::BrokenHeart(0));
+            let node = self.rewrite_refs(node, true);
+            self.areas.0[index] = node;
+        }
+        // Cheney scan over the freshly evacuated region.
+        let mut scan = scan_start;
+        while scan < self.areas.0.len() {
+            let node = mem::replace(&mut self.areas.0[scan], RuntimeNode::BrokenHeart(0));
+            let node = self.rewrite_refs(node, true);
+            self.areas.0[scan] = node;
+            scan += 1;
+        }
+        self.nursery.clear();
+        self.gc_stats.minor_collections += 1;
+        self.gc_stats.promoted_nodes += self.areas.0.len() - scan_start;
+        self.record_pause(pause_start);
     }
-    // Try to call `gc()`.
+
+    /// Fold a collection's pause into the statistics.
+    fn record_pause(&mut self, pause_start: Instant) {
+        let pause = pause_start.elapsed();
+        self.gc_stats.total_pause += pause;
+        self.gc_stats.max_pause = self.gc_stats.max_pause.max(pause);
+    }
+
+    // Try to GC.
     // Doesn't perform GC if there's enough memory to alloc a pair.
     pub fn try_gc(&mut self) {
-        let old_free = self.get_free();
-        if old_free < self.size {
+        if self.nursery.len() < self.size {
             return;
         }
-        self.gc();
+        self.minor_gc();
     }
-    fn gc_dfs(&mut self, cur: usize) -> usize {
-        let node = self.get_node(true, cur);
+
+    /// Copy a live node to the to-space (unless it is an immediate or has
+    /// already been moved) and return its new reference.
+    fn evacuate(&mut self, cur: usize) -> usize {
+        // Fixnums live in the reference itself, not in the GC area; frames
+        // live on the frame stack, which is scanned separately and never
+        // copied.
+        if cur & FIXNUM_TAG != 0 || is_frame_ref(cur) {
+            return cur;
+        }
+        let dst = self.areas.1.len();
+        let node = if is_nursery_ref(cur) {
+            &mut self.nursery[cur & !NURSERY_BASE]
+        } else {
+            &mut self.areas.0[cur]
+        };
         if let RuntimeNode::BrokenHeart(dst) = node {
             return *dst;
         }
+        let moved = mem::replace(node, RuntimeNode::BrokenHeart(dst));
+        self.areas.1.push(moved);
+        dst
+    }
 
-        let dst_length = self.get_area(false).len();
-        {
-            // Allocate the space for the new item and invalidate the old item
-            // to avoid calling `gc_dfs` on the same item again
-            let node = node.clone();
-            let dst_area = self.get_area_mut(false);
-            dst_area.push(node);
-            let src_area = self.get_area_mut(true);
-            src_area[cur] = RuntimeNode::BrokenHeart(dst_length);
-        }
-
-        let content = match self.get_node(false, dst_length) {
-            RuntimeNode::BrokenHeart(_) => panic!("Already moved"),
-            RuntimeNode::Closure(Closure {
-                name: id,
-                body,
-                env,
-                nargs,
-                variadic,
-            }) => {
-                let id = id.to_string();
-                let body = *body;
-                let nargs = *nargs;
-                let variadic = *variadic;
-                let env = self.gc_dfs(*env);
-                RuntimeNode::Closure(Closure {
-                    name: id,
-                    body,
-                    env,
-                    nargs,
-                    variadic,
-                })
+    /// [Runtime::evacuate] for minor collections: only nursery nodes move
+    /// (into the main area); main-area references are already stable.
+    fn evacuate_young(&mut self, cur: usize) -> usize {
+        if !is_nursery_ref(cur) {
+            return cur;
+        }
+        let dst = self.areas.0.len();
+        let node = &mut self.nursery[cur & !NURSERY_BASE];
+        if let RuntimeNode::BrokenHeart(dst) = node {
+            return *dst;
+        }
+        let moved = mem::replace(node, RuntimeNode::BrokenHeart(dst));
+        self.areas.0.push(moved);
+        dst
+    }
+
+    /// Rewrite every reference inside `node` through [Runtime::evacuate]
+    /// (or [Runtime::evacuate_young] when `minor` is set).
+    fn rewrite_refs(&mut self, node: RuntimeNode, minor: bool) -> RuntimeNode {
+        macro_rules! forward {
+            ($val:expr) => {
+                if minor {
+                    self.evacuate_young($val)
+                } else {
+                    self.evacuate($val)
+                }
+            };
+        }
+        match node {
+            RuntimeNode::Pair(car, cdr) => {
+                let car = forward!(car);
+                let cdr = forward!(cdr);
+                RuntimeNode::Pair(car, cdr)
             }
-            RuntimeNode::Environment(env_name, map, outer) => {
-                let outer_clone = *outer;
-                let env_name_clone = env_name.clone();
-                let mut new_map = HashMap::new();
-                for (name, var) in map_to_assoc_lst(map) {
-                    new_map.insert(name, self.gc_dfs(var));
+            RuntimeNode::Environment(payload) => {
+                // Only the references inside the payload are forwarded; the
+                // payload itself stays in its table and moves nowhere.
+                let mut env = mem::take(&mut self.env_payloads[payload]);
+                for val in env.map.values_mut() {
+                    *val = forward!(*val);
+                }
+                for val in env.args.iter_mut() {
+                    *val = forward!(*val);
                 }
-                let new_outer = outer_clone.map(|val| self.gc_dfs(val));
-                RuntimeNode::Environment(env_name_clone, new_map, new_outer)
+                if let Some(outer) = env.outer.as_mut() {
+                    *outer = forward!(*outer);
+                }
+                self.env_payloads[payload] = env;
+                RuntimeNode::Environment(payload)
             }
-            RuntimeNode::Pair(car, cdr) => {
-                let (car_val, cdr_val) = (*car, *cdr);
-                let new_car = self.gc_dfs(car_val);
-                let new_cdr = self.gc_dfs(cdr_val);
-                RuntimeNode::Pair(new_car, new_cdr)
+            RuntimeNode::Closure(payload) => {
+                let env = forward!(self.closure_payloads[payload].env);
+                self.closure_payloads[payload].env = env;
+                RuntimeNode::Closure(payload)
             }
-            _ => self.get_node(false, dst_length).clone(),
-        };
-        let dst_area = self.get_area_mut(false);
-        dst_area[dst_length] = content;
-        dst_length
+            other => other,
+        }
     }
 
-    /// Insert a node into GC area.
+    /// Record an old-to-young pointer created by mutating a main-area node.
+    fn remember(&mut self, index: usize, target: usize) {
+        // Frames are scanned as roots on every collection, so a frame
+        // pointing at the nursery needs no remembered-set entry.
+        if index & (FIXNUM_TAG | NURSERY_BASE | FRAME_BASE) == 0 && is_nursery_ref(target) {
+            self.remembered.insert(index);
+        }
+    }
+
+    /// Insert a node into the nursery.
     ///
-    /// GC area must have enough space to insert the node. You should not use
-    /// this unless you want to pin some variables to GC area.
+    /// The nursery must have enough space to insert the node. You should not
+    /// use this unless you want to pin some variables to GC area.
     fn new_node(&mut self, node: RuntimeNode) -> usize {
-        let result = self.get_free();
-        assert!(result < self.size);
-        self.get_area_mut(true).push(node);
-        result
+        assert!(self.nursery.len() < self.size);
+        self.gc_stats.allocated_nodes += 1;
+        self.nursery.push(node);
+        NURSERY_BASE | (self.nursery.len() - 1)
     }
 
     /// Perform GC and insert a node into GC area.
@@ -696,6 +1214,25 @@ impl Runtime {
         self.try_gc();
         self.new_node(node)
     }
+
+    /// Store a fresh environment payload and return its index for a slim
+    /// [RuntimeNode::Environment].
+    fn add_env_payload(&mut self, name: String, outer: Option<usize>) -> usize {
+        self.env_payloads.push(EnvPayload {
+            name,
+            map: HashMap::new(),
+            args: vec![],
+            outer,
+        });
+        self.env_payloads.len() - 1
+    }
+
+    /// Store a closure payload and return its index for a slim
+    /// [RuntimeNode::Closure].
+    fn add_closure_payload(&mut self, closure: Closure) -> usize {
+        self.closure_payloads.push(closure);
+        self.closure_payloads.len() - 1
+    }
 }
 
 // Debugger support
@@ -749,12 +1286,55 @@ impl Runtime {
         self.interrupt(DbgState::Next, msg);
     }
 
+    /// Whether this context has registered a text under the debug handle.
+    pub fn has_dbg_info(&self, handle: usize) -> bool {
+        self.dbg_texts.get(handle).is_some_and(|text| !text.is_empty())
+    }
+
+    /// Register an expression text under `handle` for
+    /// [Runtime::evaluated_id]. Like [Runtime::set_constant], slots up to
+    /// a fresh handle are filled with empty placeholders for the sites of
+    /// other units.
+    pub fn add_dbg_info(&mut self, handle: usize, text: String) {
+        if self.dbg_texts.len() <= handle {
+            self.dbg_texts.resize(handle + 1, String::new());
+        }
+        self.dbg_texts[handle] = text;
+    }
+
+    /// Like [Runtime::evaluated], but takes the handle of a registered
+    /// expression text. The text is only looked up when a debugger is
+    /// attached and stepping, so an evaluation site costs two branches.
+    pub fn evaluated_id(&mut self, id: usize, optimized: bool) {
+        if self.dbg_callback.is_none() || self.dbg_state < DbgState::Next {
+            return;
+        }
+        let info = self
+            .dbg_texts
+            .get(id)
+            .filter(|text| !text.is_empty())
+            .cloned()
+            .unwrap_or_else(|| format!("<expression {id}>"));
+        self.evaluated(&info, optimized);
+    }
+
     /// Called when a runtime API is called.
-    pub fn api_called<T>(&mut self, info: T)
+    ///
+    /// The message is built lazily: unless a debugger callback is installed
+    /// (and the `debug-api` feature is enabled) the closure is never run, so
+    /// the call costs a single branch and no allocation.
+    pub fn api_called<F, T>(&mut self, info: F)
     where
+        F: FnOnce() -> T,
         T: Display,
     {
-        self.interrupt(DbgState::Step, format!("API called: {info}"));
+        #[cfg(feature = "debug-api")]
+        if self.dbg_callback.is_some() {
+            let info = info();
+            self.interrupt(DbgState::Step, format!("API called: {info}"));
+        }
+        #[cfg(not(feature = "debug-api"))]
+        let _ = info;
     }
 
     /// Debuggers call this to enter the debug loop.
@@ -770,19 +1350,49 @@ impl Runtime {
             dbg_state: DbgState::Normal,
             stack: vec![],
             areas: (Vec::with_capacity(size), Vec::with_capacity(size)),
+            nursery: Vec::with_capacity(size),
+            remembered: HashSet::new(),
             size,
+            growth_factor: 2,
             roots: HashMap::new(),
+            registers: [REG_EMPTY; NUM_REGS],
+            constants: vec![],
+            globals: vec![],
+            frames: vec![],
+            env_stack: vec![],
+            closure_calls: vec![],
+            pending_call: None,
+            gc_stats: GcStats::default(),
             packages: HashMap::new(),
             dbg_callback: None,
+            display_buf: String::new(),
+            dbg_texts: vec![],
+            jit_log: vec![],
+            env_payloads: vec![],
+            closure_payloads: vec![],
         }
     }
 
     pub fn clear(&mut self) {
         self.roots.clear();
+        self.registers = [REG_EMPTY; NUM_REGS];
+        self.constants.clear();
+        self.globals.clear();
+        self.frames.clear();
+        self.env_stack.clear();
+        self.closure_calls.clear();
+        self.dbg_texts.clear();
+        self.jit_log.clear();
+        self.env_payloads.clear();
+        self.closure_payloads.clear();
+        self.pending_call = None;
+        self.gc_stats = GcStats::default();
         self.stack.clear();
         self.packages.clear();
         self.areas.0.clear();
         self.areas.1.clear();
+        self.nursery.clear();
+        self.remembered.clear();
         self.dbg_callback = None;
     }
 }
@@ -803,6 +1413,75 @@ impl Runtime {
     pub fn get_root(&self, name: &str) -> usize {
         *self.roots.get(name).unwrap()
     }
+
+    pub fn reg_set(&mut self, reg: usize, value: usize) {
+        self.registers[reg] = value;
+    }
+
+    pub fn reg_get(&self, reg: usize) -> usize {
+        self.registers[reg]
+    }
+
+    /// Schedule `func` to run once control unwinds to the nearest driver
+    /// loop. The callee's environment and arguments must already be prepared
+    /// (see [Runtime::prepare_args]); the function pointer itself is not a
+    /// GC reference, so no rooting is needed.
+    pub fn tail_call(&mut self, func: CVoidFunc) {
+        self.pending_call = Some(func);
+    }
+
+    /// Take the pending tail call, if any.
+    pub fn next_call(&mut self) -> Option<CVoidFunc> {
+        self.pending_call.take()
+    }
+
+    /// Whether this context has parsed its copy of the constant `handle`.
+    /// Callers check this before parsing, so a unit re-running its startup
+    /// block in a warm context costs a bounds check per literal.
+    pub fn has_constant(&self, handle: usize) -> bool {
+        self.constants.get(handle).is_some_and(|&node| node != REG_EMPTY)
+    }
+
+    /// Move the top of the stack into the constant pool as this context's
+    /// node for `handle`. Slots between the pool's end and a fresh handle
+    /// are filled with [REG_EMPTY]; they belong to pooling sites of other
+    /// units and are only ever written by this method.
+    pub fn set_constant(&mut self, handle: usize) {
+        let index = self.pop();
+        if self.constants.len() <= handle {
+            self.constants.resize(handle + 1, REG_EMPTY);
+        }
+        self.constants[handle] = index;
+    }
+
+    pub fn get_constant(&self, handle: usize) -> usize {
+        self.constants[handle]
+    }
+
+    /// The statistics gathered by the collectors so far.
+    pub fn gc_stats(&self) -> &GcStats {
+        &self.gc_stats
+    }
+
+    /// Grow the GC area to hold at least `size` nodes, so a program with a
+    /// known working set does not pay a full copy per area doubling while
+    /// ramping up. Never shrinks.
+    pub fn reserve(&mut self, size: usize) {
+        if size <= self.size {
+            return;
+        }
+        self.size = size;
+        self.areas.0.reserve(size.saturating_sub(self.areas.0.len()));
+        self.areas.1.reserve(size.saturating_sub(self.areas.1.len()));
+        self.nursery.reserve(size - self.nursery.len());
+    }
+
+    /// Set the factor the GC area grows by; values below 2 are ignored.
+    pub fn set_growth_factor(&mut self, factor: usize) {
+        if factor >= 2 {
+            self.growth_factor = factor;
+        }
+    }
 }
 
 // Getter
@@ -829,16 +1508,34 @@ impl Runtime {
         self.size
     }
     pub fn get_node(&self, active: bool, index: usize) -> &RuntimeNode {
+        if is_nursery_ref(index) {
+            return self.nursery.get(index & !NURSERY_BASE).unwrap();
+        }
+        if is_frame_ref(index) {
+            return self.frames.get(index & !FRAME_BASE).unwrap();
+        }
         self.get_area(active).get(index).unwrap()
     }
 
     pub fn get_node_mut(&mut self, active: bool, index: usize) -> &mut RuntimeNode {
+        if is_nursery_ref(index) {
+            return self.nursery.get_mut(index & !NURSERY_BASE).unwrap();
+        }
+        if is_frame_ref(index) {
+            return self.frames.get_mut(index & !FRAME_BASE).unwrap();
+        }
         self.get_area_mut(active).get_mut(index).unwrap()
     }
     /// Get the underlying C function pointer of a closure.
     pub fn get_c_func(&self, index: usize) -> Result<Option<CVoidFunc>, RuntimeError> {
-        if let RuntimeNode::Closure(c) = self.get_node(true, index) {
-            Ok(Some(c.body))
+        if index_to_fixnum(index).is_some() {
+            return Err(RuntimeError::new(format!(
+                "{} is not a closure",
+                self.display_node_idx(index)
+            )));
+        }
+        if let RuntimeNode::Closure(payload) = self.get_node(true, index) {
+            Ok(Some(self.closure_payloads[*payload].body))
         } else {
             Err(RuntimeError::new(format!(
                 "{} is not a number",
@@ -847,6 +1544,9 @@ impl Runtime {
         }
     }
     pub fn get_number(&self, index: usize) -> Result<Number, RuntimeError> {
+        if let Some(value) = index_to_fixnum(index) {
+            return Ok(Number::Int(value));
+        }
         if let RuntimeNode::Number(val) = self.get_node(true, index) {
             Ok(val.clone())
         } else {
@@ -857,6 +1557,12 @@ impl Runtime {
         }
     }
     pub fn get_symbol(&self, index: usize) -> Result<Symbol, RuntimeError> {
+        if index_to_fixnum(index).is_some() {
+            return Err(RuntimeError::new(format!(
+                "{} is not a symbol",
+                self.display_node_idx(index)
+            )));
+        }
         if let RuntimeNode::Symbol(val) = self.get_node(true, index) {
             Ok(val.clone())
         } else {
@@ -867,6 +1573,12 @@ impl Runtime {
         }
     }
     pub fn get_pair(&self, index: usize) -> Result<(usize, usize), RuntimeError> {
+        if index_to_fixnum(index).is_some() {
+            return Err(RuntimeError::new(format!(
+                "{} is not a pair",
+                self.display_node_idx(index)
+            )));
+        }
         if let RuntimeNode::Pair(car, cdr) = self.get_node(true, index) {
             Ok((*car, *cdr))
         } else {
@@ -886,7 +1598,8 @@ impl Runtime {
         self.try_gc();
 
         outer = self.pop();
-        self.new_node(RuntimeNode::Environment(name, HashMap::new(), Some(outer)))
+        let payload = self.add_env_payload(name, Some(outer));
+        self.new_node(RuntimeNode::Environment(payload))
     }
 
     pub fn current_env(&self) -> usize {
@@ -894,24 +1607,82 @@ impl Runtime {
         *self.roots.get(env_name).unwrap()
     }
 
+    /// Allocate a non-escaping call frame on the frame stack and return its
+    /// [FRAME_BASE]-tagged reference. Unlike [Runtime::new_env] this never
+    /// triggers a collection: the frame is not a heap object.
+    fn push_frame(&mut self, name: String, outer: usize) -> usize {
+        let payload = self.add_env_payload(name, Some(outer));
+        self.frames.push(RuntimeNode::Environment(payload));
+        FRAME_BASE | (self.frames.len() - 1)
+    }
+
+    /// Save the current environment and the frame-stack watermark before a
+    /// non-tail call; the matching [Runtime::restore_env] returns to it.
+    pub fn save_env(&mut self) {
+        self.env_stack.push((self.current_env(), self.frames.len()));
+    }
+
+    /// Return from a non-tail call: pop every frame the call pushed and
+    /// move back to the saved environment.
+    pub fn restore_env(&mut self) {
+        let (env, watermark) = self.env_stack.pop().expect("Environment stack underflow");
+        self.frames.truncate(watermark);
+        self.move_to_env(env);
+    }
+
+    /// Discard the current frame (and anything above it) before a tail
+    /// call: the activation is over, so without this a self-recursive loop
+    /// of non-escaping calls would grow the frame stack by one frame per
+    /// iteration. A no-op when the current environment is a heap node.
+    pub fn drop_frame(&mut self) {
+        let env = self.current_env();
+        if is_frame_ref(env) {
+            self.frames.truncate(env & !FRAME_BASE);
+        }
+    }
+
+    /// Create the top-level environment. Its node carries no variables of
+    /// its own — they are stored in [Runtime::global_set]'s flat table — so
+    /// the node the collectors copy stays constant-sized no matter how many
+    /// globals the program defines.
     pub fn top_env(&mut self) -> usize {
         let cur_name = "__cur_env";
         let top_name = "__top_env";
         assert!(!self.roots.contains_key(cur_name));
         assert!(!self.roots.contains_key(top_name));
-        let node = self.new_node_with_gc(RuntimeNode::Environment(
-            "top".to_string(),
-            HashMap::new(),
-            None,
-        ));
+        let payload = self.add_env_payload("top".to_string(), None);
+        let node = self.new_node_with_gc(RuntimeNode::Environment(payload));
         self.roots.insert(top_name.to_string(), node);
         self.roots.insert(cur_name.to_string(), node);
         node
     }
 
-    pub fn get_cur_env(&self, idx: usize, key: &String) -> Option<usize> {
-        if let RuntimeNode::Environment(_, map, _) = self.get_node(true, idx) {
-            map.get(key).copied()
+    /// Whether `idx` is the top-level environment, whose variables live in
+    /// the flat global table rather than in the node's map.
+    pub fn is_top_env(&self, idx: usize) -> bool {
+        self.roots.get("__top_env") == Some(&idx)
+    }
+
+    /// Look up a global by atom id: a single array access.
+    pub fn global_get(&self, id: AtomId) -> Option<usize> {
+        self.globals.get(id as usize).copied().flatten()
+    }
+
+    /// Define or overwrite a global by atom id.
+    pub fn global_set(&mut self, id: AtomId, value: usize) {
+        let slot = id as usize;
+        if slot >= self.globals.len() {
+            self.globals.resize(slot + 1, None);
+        }
+        self.globals[slot] = Some(value);
+    }
+
+    pub fn get_cur_env(&self, idx: usize, key: &str) -> Option<usize> {
+        if self.is_top_env(idx) {
+            return self.global_get(intern(key));
+        }
+        if let RuntimeNode::Environment(payload) = self.get_node(true, idx) {
+            self.env_payloads[*payload].map.get(key).copied()
         } else {
             log_error(format!(
                 "Expect an environment, found {}",
@@ -922,7 +1693,7 @@ impl Runtime {
     }
 
     pub fn move_to_env(&mut self, env: usize) {
-        if let RuntimeNode::Environment(_, _, _) = self.get_node(true, env) {
+        if let RuntimeNode::Environment(_) = self.get_node(true, env) {
             self.set_root("__cur_env".to_string(), env);
         } else {
             panic!("Not an environment")
@@ -930,30 +1701,85 @@ impl Runtime {
     }
 
     pub fn get_outer_env(&self, idx: usize) -> Option<usize> {
-        if let RuntimeNode::Environment(_, _, outer) = self.get_node(true, idx) {
-            *outer
+        if let RuntimeNode::Environment(payload) = self.get_node(true, idx) {
+            self.env_payloads[*payload].outer
         } else {
             panic!("Not an environment")
         }
     }
 
-    pub fn insert_cur_env(&mut self, idx: usize, key: &String, value: usize) {
-        if let RuntimeNode::Environment(_, map, _) = self.get_node_mut(true, idx) {
-            map.insert(key.to_string(), value);
+    pub fn insert_cur_env(&mut self, idx: usize, key: &str, value: usize) {
+        if self.is_top_env(idx) {
+            // The global table is a GC root, so no remembered-set entry is
+            // needed for a nursery value stored here.
+            self.global_set(intern(key), value);
+            return;
+        }
+        self.remember(idx, value);
+        if let RuntimeNode::Environment(payload) = *self.get_node(true, idx) {
+            let env = &mut self.env_payloads[payload];
+            // Keep the argument slots in sync with the positional parameters
+            // in the map, so `get_local` always sees the latest value.
+            if let Some(slot) = positional_slot(key) {
+                if slot < env.args.len() {
+                    env.args[slot] = value;
+                } else if slot == env.args.len() {
+                    env.args.push(value);
+                }
+            }
+            env.map.insert(key.to_string(), value);
         } else {
             panic!("Not an environment")
         }
     }
+
+    /// Resolve a lexical address: walk `depth` outer environments from the
+    /// current one, then read argument slot `slot`.
+    ///
+    /// The compiler emits this for positional parameters (`#slot_func_{id}`)
+    /// whose defining lambda is known at compile time, replacing a chain of
+    /// hash lookups with two array indexes.
+    pub fn get_local(&self, depth: usize, slot: usize) -> Result<usize, RuntimeError> {
+        let mut env = self.current_env();
+        for _ in 0..depth {
+            env = self.get_outer_env(env).ok_or_else(|| {
+                RuntimeError::new(format!("lexical address ({depth}, {slot}) is too deep"))
+            })?;
+        }
+        if let RuntimeNode::Environment(payload) = self.get_node(true, env) {
+            self.env_payloads[*payload].args.get(slot).copied().ok_or_else(|| {
+                RuntimeError::new(format!(
+                    "no argument slot {slot} in {}",
+                    self.display_node_idx(env)
+                ))
+            })
+        } else {
+            Err(RuntimeError::new("Not an environment".to_string()))
+        }
+    }
+}
+
+/// The argument slot of a positional parameter name (`#slot_func_{id}`),
+/// or `None` if the name is not positional.
+fn positional_slot(key: &str) -> Option<usize> {
+    let rest = key.strip_prefix('#')?;
+    let (slot, _) = rest.split_once('_')?;
+    slot.parse().ok()
 }
 
 // Closures
 impl Runtime {
     /// Get a closure from the stack, move to an environment whose outer is its `env`.
     fn move_to_closure_env(&mut self, cid: usize) -> Result<Closure, RuntimeError> {
-        if let RuntimeNode::Closure(c) = self.get_node(true, cid) {
-            let c = c.clone();
-            // Construct and move to an environment.
-            let env = self.new_env("closure".to_string(), c.env);
+        if let RuntimeNode::Closure(payload) = self.get_node(true, cid) {
+            let c = self.closure_payloads[*payload].clone();
+            // Construct and move to an environment: a heap node when the
+            // body captures it, a frame-stack entry otherwise.
+            let env = if c.escapes {
+                self.new_env("closure".to_string(), c.env)
+            } else {
+                self.push_frame("closure".to_string(), c.env)
+            };
             self.move_to_env(env);
             Ok(c)
         } else {
@@ -988,6 +1814,32 @@ impl Runtime {
         }
     }
 
+    /// Record one invocation of the closure in the profile. Compiled
+    /// closures are named by their numeric lambda id; anything else (e.g.
+    /// closures built by hand in tests) is not tracked.
+    fn count_closure_call(&mut self, name: &str) {
+        if let Ok(id) = name.parse::<usize>() {
+            if id >= self.closure_calls.len() {
+                self.closure_calls.resize(id + 1, 0);
+            }
+            self.closure_calls[id] += 1;
+        }
+    }
+
+    /// The closure invocation counts as `(lambda id, calls)` pairs, hottest
+    /// first. Ids map to `func_{id}` in the generated C.
+    pub fn closure_hot_list(&self) -> Vec<(usize, usize)> {
+        let mut hot: Vec<(usize, usize)> = self
+            .closure_calls
+            .iter()
+            .enumerate()
+            .filter(|&(_, &calls)| calls > 0)
+            .map(|(id, &calls)| (id, calls))
+            .collect();
+        hot.sort_by(|a, b| b.1.cmp(&a.1).then(a.0.cmp(&b.0)));
+        hot
+    }
+
     /// Pop the arguments from the stack and save them in a new environment.
     ///
     /// The stack before the function is called should be
@@ -995,6 +1847,7 @@ impl Runtime {
     /// `#0_func_{func_id}`, `operand1` has name `#1_func_{func_id}`, etc.
     pub fn prepare_args(&mut self, cid: usize) -> Result<(), RuntimeError> {
         let c = self.move_to_closure_env(cid)?;
+        self.count_closure_call(&c.name);
 
         let idx = self.pop();
         let nparams = usize::try_from(self.get_number(idx)?)?;
@@ -1016,9 +1869,9 @@ impl Runtime {
 
             if c.variadic {
                 if c.nargs <= nparams {
-                    // Zip the rest of the arguments (args[c.nargs-1..nparams])
-                    // if the closure is variadic.
-                    self.zip_stack_nodes(nparams - c.nargs + 1);
+                    // Pack the rest of the arguments (args[c.nargs-1..nparams])
+                    // into a list if the closure is variadic.
+                    self.new_list(nparams - c.nargs + 1);
                 } else {
                     // Load a '() as the last argument.
                     Symbol::Nil.load_to(self).unwrap();
@@ -1035,17 +1888,88 @@ impl Runtime {
     }
 }
 
+// Inlined primitives.
+//
+// The compiler emits these directly for applications of statically-known
+// builtins (which cannot be rebound: `define` and `set!` only accept user
+// symbols), skipping the nargs node, the operator node and the dispatch
+// match in [StackMachine::apply].
+impl Runtime {
+    /// The open-coded `car` primitive: pop a pair, push its car.
+    pub fn car(&mut self) -> Result<(), RuntimeError> {
+        let index = self.pop();
+        let (car, _) = self.get_pair(index)?;
+        self.push(car);
+        Ok(())
+    }
+    /// The open-coded `cdr` primitive: pop a pair, push its cdr.
+    pub fn cdr(&mut self) -> Result<(), RuntimeError> {
+        let index = self.pop();
+        let (_, cdr) = self.get_pair(index)?;
+        self.push(cdr);
+        Ok(())
+    }
+    /// The open-coded binary arithmetic primitives. Fixnum operands go
+    /// through [Number] without touching the GC area at all.
+    pub fn arith2<Op>(&mut self, op: Op) -> Result<(), RuntimeError>
+    where
+        Op: Fn(Number, Number) -> Number,
+    {
+        let lhs = self.pop();
+        let rhs = self.pop();
+        let lhs = self.get_number(lhs)?;
+        let rhs = self.get_number(rhs)?;
+        op(lhs, rhs)
+            .load_to(self)
+            .map_err(|e| RuntimeError::new(e.to_string()))
+    }
+}
+
 // Misc
 impl Runtime {
     pub fn node_vec_from_stack(&mut self, nargs: usize) -> Vec<RuntimeNode> {
         let mut operands = vec![];
         for _ in 0..nargs {
             let idx = self.pop();
-            let node = self.get_node(true, idx).clone();
+            let node = self.clone_node(idx);
             operands.push(node);
         }
         operands
     }
+    /// Clone the node behind a reference, materializing fixnums as numbers.
+    fn clone_node(&self, index: usize) -> RuntimeNode {
+        match index_to_fixnum(index) {
+            Some(value) => RuntimeNode::Number(Number::Int(value)),
+            None => self.get_node(true, index).clone(),
+        }
+    }
+    /// Build an `n`-element list from the stack in one pass. The stack
+    /// before the call is `(top) a1 a2 ... an`; afterwards the list
+    /// `(a1 a2 ... an)` is at the top.
+    ///
+    /// Space for the whole spine is reserved up front, so the build loop
+    /// allocates without polling the GC once per pair the way
+    /// [Runtime::zip_stack_nodes] does.
+    pub fn new_list(&mut self, n: usize) {
+        // n pairs plus the trailing nil.
+        if self.nursery.len() + n + 1 > self.size {
+            self.minor_gc();
+        }
+        if self.nursery.len() + n + 1 > self.size {
+            // The spine alone outgrows the nursery; fall back to
+            // pair-at-a-time construction, which can collect mid-build
+            // because the partial list stays reachable through the stack.
+            self.zip_stack_nodes(n);
+            return;
+        }
+        let elems: Vec<usize> = (0..n).map(|_| self.pop()).collect();
+        let mut list = self.new_node(RuntimeNode::Symbol(Symbol::Nil));
+        for elem in elems.into_iter().rev() {
+            list = self.new_node(RuntimeNode::Pair(elem, list));
+        }
+        self.push(list);
+    }
+
     pub fn zip_stack_nodes(&mut self, nargs: usize) {
         // (top) a1 a2 ... an -> (top) an ... a2 a1
         let mut nodes = Vec::with_capacity(nargs);
@@ -1065,28 +1989,38 @@ impl Runtime {
             // (top) (a_k a_{k+1} ... a_n) a_{k-1} ... a_2 a_1
         }
     }
-    fn pop_as_node(&mut self) -> RuntimeNode {
-        let index = self.pop();
-        self.get_node(true, index).clone()
-    }
-
+    /// Reflect the runtime node at `index` into `ast` and return its id.
+    ///
+    /// `visited` maps runtime indices to their arena ids so shared structure
+    /// (and cycles) in the heap stays shared in the tree.
     pub fn to_node(
         &self,
         index: usize,
-        visited: &mut HashMap<usize, Rc<RefCell<Node>>>,
-    ) -> Rc<RefCell<Node>> {
-        if visited.contains_key(&index) {
-            return visited.get(&index).unwrap().clone();
+        ast: &mut Ast,
+        visited: &mut HashMap<usize, NodeId>,
+    ) -> NodeId {
+        if let Some(id) = visited.get(&index) {
+            return *id;
+        }
+        if let Some(value) = index_to_fixnum(index) {
+            return ast.add(Node::Number(Number::Int(value)));
         }
         match self.get_node(true, index) {
             RuntimeNode::BrokenHeart(dst) => {
-                Node::Symbol(Symbol::User(format!("<BrokenHeart {dst}>"))).into()
+                let node = Node::String(format!("<BrokenHeart {dst}>"));
+                ast.add(node)
+            }
+            RuntimeNode::Closure(payload) => {
+                // A transient description, not a real symbol: interning it
+                // would grow the atom table on every display.
+                let Closure { env, nargs, .. } = &self.closure_payloads[*payload];
+                let node = Node::String(format!("<Closure env: {env}, nargs: {nargs}>"));
+                ast.add(node)
             }
-            RuntimeNode::Closure(Closure { env, nargs, .. }) => Node::Symbol(Symbol::User(
-                format!("<Closure env: {env}, nargs: {nargs}>"),
-            ))
-            .into(),
-            RuntimeNode::Environment(name, map, outer) => {
+            RuntimeNode::Environment(payload) => {
+                let EnvPayload {
+                    name, map, outer, ..
+                } = &self.env_payloads[*payload];
                 let mut result = format!("<Env {name}: ");
                 for (k, v) in map {
                     result += &format!("{k}={v}, ");
@@ -1094,26 +2028,28 @@ impl Runtime {
                 if let Some(env) = outer {
                     result += &format!("; outer = {env}");
                 }
-                Node::Symbol(Symbol::User(format!("{result}>"))).into()
+                ast.add(Node::String(format!("{result}>")))
+            }
+            RuntimeNode::Number(val) => {
+                let node = Node::Number(val.clone());
+                ast.add(node)
             }
-            RuntimeNode::Number(val) => Node::Number(val.clone()).into(),
             RuntimeNode::Pair(car, cdr) => {
-                let pair = Rc::new(RefCell::new(Node::Pair(
-                    Node::Symbol(Symbol::Nil).into(),
-                    Node::Symbol(Symbol::Nil).into(),
-                )));
-                visited.insert(index, pair.clone());
-                let car_node = self.to_node(*car, visited);
-                let cdr_node = self.to_node(*cdr, visited);
-                if let Node::Pair(car, cdr) = &mut *pair.borrow_mut() {
-                    *car = car_node;
-                    *cdr = cdr_node;
-                } else {
-                    unreachable!()
-                }
+                let (car, cdr) = (*car, *cdr);
+                // Allocate the pair before recursing so a cycle through it
+                // finds the placeholder in `visited`, then patch the children.
+                let nil = ast.nil();
+                let pair = ast.pair(nil, nil);
+                visited.insert(index, pair);
+                let car_node = self.to_node(car, ast, visited);
+                let cdr_node = self.to_node(cdr, ast, visited);
+                *ast.get_mut(pair) = Node::Pair(car_node, cdr_node);
                 pair
             }
-            RuntimeNode::Symbol(val) => Node::Symbol(val.clone()).into(),
+            RuntimeNode::Symbol(val) => {
+                let node = Node::Symbol(*val);
+                ast.add(node)
+            }
         }
     }
 
@@ -1129,9 +2065,14 @@ impl Runtime {
         index: usize,
         target: usize,
     ) -> Result<(), RuntimeError> {
-        let area = self.get_area_mut(active);
-        let box_val = area.get_mut(index).unwrap();
-        if let RuntimeNode::Pair(car, _) = box_val {
+        if index_to_fixnum(index).is_some() {
+            return Err(RuntimeError::new(format!(
+                "{} is not a pair",
+                self.display_node_idx(index)
+            )));
+        }
+        self.remember(index, target);
+        if let RuntimeNode::Pair(car, _) = self.get_node_mut(active, index) {
             *car = target;
             Ok(())
         } else {
@@ -1148,9 +2089,14 @@ impl Runtime {
         index: usize,
         target: usize,
     ) -> Result<(), RuntimeError> {
-        let area = self.get_area_mut(active);
-        let box_val = area.get_mut(index).unwrap();
-        if let RuntimeNode::Pair(_, cdr) = box_val {
+        if index_to_fixnum(index).is_some() {
+            return Err(RuntimeError::new(format!(
+                "{} is not a pair",
+                self.display_node_idx(index)
+            )));
+        }
+        self.remember(index, target);
+        if let RuntimeNode::Pair(_, cdr) = self.get_node_mut(active, index) {
             *cdr = target;
             Ok(())
         } else {
@@ -1161,10 +2107,143 @@ impl Runtime {
         }
     }
 
+    /// Insert `index` into the visited map if it is a pair. Cycles can only
+    /// go through pairs, so tracking atoms would print spurious `#n#`
+    /// references. The counterpart of [crate::node::Ast]'s `visit`.
+    fn visit_idx(&self, visited: &mut HashMap<usize, usize>, index: usize, disp_id: usize) {
+        if index_to_fixnum(index).is_none()
+            && matches!(self.get_node(true, index), RuntimeNode::Pair(..))
+        {
+            visited.insert(index, disp_id);
+        }
+    }
+
+    /// Write the displayed form of an atom (anything but a pair) into `out`.
+    fn write_atom(&self, out: &mut String, index: usize) {
+        if let Some(value) = index_to_fixnum(index) {
+            out.push_str(&value.to_string());
+            return;
+        }
+        match self.get_node(true, index) {
+            RuntimeNode::BrokenHeart(dst) => {
+                out.push_str(&format!("\"<BrokenHeart {dst}>\""));
+            }
+            RuntimeNode::Closure(payload) => {
+                let Closure { env, nargs, .. } = &self.closure_payloads[*payload];
+                out.push_str(&format!("\"<Closure env: {env}, nargs: {nargs}>\""));
+            }
+            RuntimeNode::Environment(payload) => {
+                let EnvPayload {
+                    name, map, outer, ..
+                } = &self.env_payloads[*payload];
+                out.push_str(&format!("\"<Env {name}: "));
+                for (k, v) in map {
+                    out.push_str(&format!("{k}={v}, "));
+                }
+                if let Some(env) = outer {
+                    out.push_str(&format!("; outer = {env}"));
+                }
+                out.push_str(">\"");
+            }
+            RuntimeNode::Number(val) => out.push_str(&val.to_string()),
+            RuntimeNode::Symbol(val) => out.push_str(&val.to_string()),
+            RuntimeNode::Pair(..) => unreachable!(),
+        }
+    }
+
+    /// Write the displayed form of the node at `index` into `out`, walking
+    /// the runtime graph directly instead of building a parallel [Ast].
+    /// `visited` maps pair indices to display ids for `#n#` cycle
+    /// references, mirroring [crate::node::AstDisplay]'s output.
+    fn write_node(
+        &self,
+        out: &mut String,
+        index: usize,
+        visited: &mut HashMap<usize, usize>,
+        disp_id: usize,
+    ) {
+        if index_to_fixnum(index).is_some() {
+            return self.write_atom(out, index);
+        }
+        let (car, cdr) = match self.get_node(true, index) {
+            RuntimeNode::Pair(car, cdr) => (*car, *cdr),
+            _ => return self.write_atom(out, index),
+        };
+
+        if let Some(prev_id) = visited.get(&cdr) {
+            out.push_str(&format!("#{prev_id}#"));
+            return;
+        }
+        self.visit_idx(visited, cdr, disp_id);
+
+        if let Some(prev_id) = visited.get(&car) {
+            out.push_str(&format!("(#{prev_id}#"));
+        } else {
+            out.push('(');
+            self.write_node(out, car, visited, disp_id);
+            self.visit_idx(visited, car, disp_id);
+        }
+
+        let mut current = cdr;
+        let mut current_id = disp_id;
+        loop {
+            match self.get_node_or_fixnum(current) {
+                Some(RuntimeNode::Pair(next_car, next_cdr)) => {
+                    let (next_car, next_cdr) = (*next_car, *next_cdr);
+                    if let Some(prev_id) = visited.get(&next_cdr) {
+                        out.push_str(&format!(" . #{prev_id}#"));
+                        break;
+                    }
+
+                    let next_id = current_id + 1;
+                    self.visit_idx(visited, next_cdr, next_id);
+
+                    if let Some(prev_id) = visited.get(&next_car) {
+                        out.push_str(&format!(" #{prev_id}#"));
+                    } else {
+                        out.push(' ');
+                        self.write_node(out, next_car, visited, next_id);
+                        self.visit_idx(visited, next_car, next_id);
+                    }
+                    current = next_cdr;
+                    current_id = next_id;
+                }
+                Some(RuntimeNode::Symbol(Symbol::Nil)) => break,
+                _ => {
+                    out.push_str(" . ");
+                    self.write_atom(out, current);
+                    break;
+                }
+            }
+        }
+        out.push(')');
+    }
+
+    /// [Runtime::get_node] unless the reference is an immediate fixnum.
+    fn get_node_or_fixnum(&self, index: usize) -> Option<&RuntimeNode> {
+        if index_to_fixnum(index).is_some() {
+            None
+        } else {
+            Some(self.get_node(true, index))
+        }
+    }
+
     pub fn display_node_idx(&self, index: usize) -> String {
-        let mut visited = HashMap::new();
-        let node = self.to_node(index, &mut visited);
-        format!("{}", node.borrow())
+        let mut out = String::new();
+        self.write_node(&mut out, index, &mut HashMap::new(), 0);
+        out
+    }
+
+    /// [Runtime::display_node_idx] into the runtime's reusable display
+    /// buffer, returning a NUL-terminated pointer for C callers. The
+    /// pointer stays valid until the next call and must not be freed.
+    pub fn display_node_buf(&mut self, index: usize) -> *const i8 {
+        let mut out = mem::take(&mut self.display_buf);
+        out.clear();
+        self.write_node(&mut out, index, &mut HashMap::new(), 0);
+        out.push('\0');
+        self.display_buf = out;
+        self.display_buf.as_ptr() as *const i8
     }
 
     /// Create a pair using the two elements from the stack. The first element
@@ -1177,19 +2256,68 @@ impl Runtime {
         self.push(pair);
     }
 
-    pub fn node_eq(&self, a: usize, b: usize) -> bool {
+    /// Shallow equality used by `eq?`: two nodes are equal if they are the
+    /// same node, the same fixnum, or atoms (symbols and numbers) with the
+    /// same value. Pairs are only `eq?` to themselves.
+    pub fn node_id_eq(&self, a: usize, b: usize) -> bool {
+        if a == b {
+            return true;
+        }
+        // Fixnums compare by value; a fixnum can still equal a boxed number
+        // built directly from a [RuntimeNode].
+        match (index_to_fixnum(a), index_to_fixnum(b)) {
+            (Some(a), Some(b)) => return a == b,
+            (Some(a), None) => {
+                return matches!(self.get_node(true, b),
+                    RuntimeNode::Number(n) if *n == Number::Int(a));
+            }
+            (None, Some(b)) => {
+                return matches!(self.get_node(true, a),
+                    RuntimeNode::Number(n) if *n == Number::Int(b));
+            }
+            (None, None) => {}
+        }
         match (self.get_node(true, a), self.get_node(true, b)) {
             (RuntimeNode::Symbol(a), RuntimeNode::Symbol(b)) => a == b,
             (RuntimeNode::Number(a), RuntimeNode::Number(b)) => a == b,
-            (RuntimeNode::Pair(a, b), RuntimeNode::Pair(c, d)) => {
-                self.node_eq(*a, *c) && self.node_eq(*b, *d)
+            (_, _) => false,
+        }
+    }
+
+    /// Deep structural equality used by `equal?`. The walk is iterative with
+    /// an explicit worklist so long lists do not overflow the Rust stack.
+    pub fn node_eq(&self, a: usize, b: usize) -> bool {
+        let mut worklist = vec![(a, b)];
+        while let Some((a, b)) = worklist.pop() {
+            if self.node_id_eq(a, b) {
+                continue;
             }
-            (RuntimeNode::Environment(a, b, c), RuntimeNode::Environment(d, e, f)) => {
-                a == d && b == e && c == f
+            if index_to_fixnum(a).is_some() || index_to_fixnum(b).is_some() {
+                return false;
+            }
+            match (self.get_node(true, a), self.get_node(true, b)) {
+                (RuntimeNode::Pair(a, b), RuntimeNode::Pair(c, d)) => {
+                    worklist.push((*b, *d));
+                    worklist.push((*a, *c));
+                }
+                (RuntimeNode::Environment(a), RuntimeNode::Environment(b)) => {
+                    if self.env_payloads[*a] != self.env_payloads[*b] {
+                        return false;
+                    }
+                }
+                (RuntimeNode::Closure(a), RuntimeNode::Closure(b)) => {
+                    if self.closure_payloads[*a] != self.closure_payloads[*b] {
+                        return false;
+                    }
+                }
+                (RuntimeNode::BrokenHeart(a), RuntimeNode::BrokenHeart(b)) => {
+                    if a != b {
+                        return false;
+                    }
+                }
+                (_, _) => return false,
             }
-            (RuntimeNode::Closure(a), RuntimeNode::Closure(b)) => a == b,
-            (RuntimeNode::BrokenHeart(a), RuntimeNode::BrokenHeart(b)) => a == b,
-            (_, _) => false,
         }
+        true
     }
 }
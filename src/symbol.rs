@@ -1,6 +1,53 @@
 //! Symbols and special forms.
 
-use std::{collections::HashMap, fmt::Display, str::FromStr, sync::LazyLock};
+use std::{
+    collections::HashMap,
+    fmt::Display,
+    str::FromStr,
+    sync::{LazyLock, RwLock},
+};
+
+/// The id of an interned symbol name in the process-wide atom table.
+pub type AtomId = u32;
+
+/// The process-wide atom table.
+///
+/// Compiled units intern every symbol name once at startup (see
+/// `rt_intern`) and refer to it by [AtomId] afterwards, so separately
+/// JIT-compiled expressions agree on the ids.
+struct AtomTable {
+    names: Vec<&'static str>,
+    ids: HashMap<&'static str, AtomId>,
+}
+
+static ATOMS: LazyLock<RwLock<AtomTable>> = LazyLock::new(|| {
+    RwLock::new(AtomTable {
+        names: vec![],
+        ids: HashMap::new(),
+    })
+});
+
+/// Intern a symbol name, returning its [AtomId]. Idempotent.
+pub fn intern(name: &str) -> AtomId {
+    let mut table = ATOMS.write().unwrap();
+    if let Some(id) = table.ids.get(name) {
+        return *id;
+    }
+    // The name is leaked so that resolved `&'static str`s stay valid for the
+    // lifetime of the process. The table is append-only and bounded by the
+    // number of distinct symbols in the program, so this is not a leak in
+    // practice.
+    let name: &'static str = Box::leak(name.to_string().into_boxed_str());
+    let id = table.names.len() as AtomId;
+    table.names.push(name);
+    table.ids.insert(name, id);
+    id
+}
+
+/// Resolve an [AtomId] back to its name. Panics on an unknown id.
+pub fn atom_name(id: AtomId) -> &'static str {
+    ATOMS.read().unwrap().names[id as usize]
+}
 
 pub static SPECIAL_FORMS: LazyLock<HashMap<&'static str, SpecialForm>> = LazyLock::new(|| {
     HashMap::from([
@@ -32,6 +79,7 @@ pub static SYMBOLS: LazyLock<HashMap<&'static str, Symbol>> = LazyLock::new(|| {
         ("atom?", Symbol::Atom),
         ("number?", Symbol::Number),
         ("eq?", Symbol::Eq),
+        ("equal?", Symbol::Equal),
         ("car", Symbol::Car),
         ("cdr", Symbol::Cdr),
         ("cons", Symbol::Cons),
@@ -184,7 +232,7 @@ pub enum SpecialForm {
     Apply,
 }
 
-#[derive(Debug, Clone, PartialEq, Eq, Hash)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
 pub enum Symbol {
     /// Built-in symbol `nil`.
     ///
@@ -203,8 +251,14 @@ pub enum Symbol {
     /// Built-in symbol `eq?`.
     ///
     /// `(eq? x y)` evaluates `x` and `y` and return `t` if their values are
-    /// the same, otherwise return `f`.
+    /// the same object (or the same symbol or number), otherwise return `f`.
+    /// Use `equal?` to compare lists element by element.
     Eq,
+    /// Built-in symbol `equal?`.
+    ///
+    /// `(equal? x y)` evaluates `x` and `y` and return `t` if their values
+    /// are structurally equal, otherwise return `f`.
+    Equal,
     /// Built-in symbol `car`.
     ///
     /// `(car x)` evaluates `x` and return the first element of the list.
@@ -302,8 +356,12 @@ pub enum Symbol {
     /// `(= x1 x2)` evaluates `x1` and `x2` and return `t` if `x1` is equal to
     /// `x2`, otherwise return `f`.
     EqNum,
-    /// User-defined symbol.
-    User(String),
+    /// User-defined symbol, referred to by its interned [AtomId].
+    ///
+    /// Comparing two user symbols is an integer compare and cloning one
+    /// copies four bytes; [atom_name] resolves the id back to its name for
+    /// display.
+    User(AtomId),
 }
 
 impl FromStr for SpecialForm {
@@ -323,7 +381,7 @@ impl<T: Into<String>> From<T> for Symbol {
         SYMBOLS
             .get(value.as_str())
             .cloned()
-            .unwrap_or(Symbol::User(value))
+            .unwrap_or_else(|| Symbol::User(intern(&value)))
     }
 }
 
@@ -356,11 +414,12 @@ impl Display for SpecialForm {
 impl Display for Symbol {
     fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
         match self {
-            Symbol::User(str) => write!(f, "{str}"),
+            Symbol::User(id) => write!(f, "{}", atom_name(*id)),
             Symbol::Nil => write!(f, "nil"),
             Symbol::Atom => write!(f, "atom?"),
             Symbol::Number => write!(f, "number?"),
             Symbol::Eq => write!(f, "eq?"),
+            Symbol::Equal => write!(f, "equal?"),
             Symbol::Car => write!(f, "car"),
             Symbol::Cdr => write!(f, "cdr"),
             Symbol::Cons => write!(f, "cons"),
@@ -1,15 +1,18 @@
 //! Utility functions.
 
 use std::{
-    cell::RefCell,
     collections::HashMap,
     ffi::c_void,
     fmt::Display,
-    rc::Rc,
     sync::atomic::{AtomicUsize, Ordering},
 };
 
-use crate::{lexer::Number, nil, node::Node, symbol::Symbol};
+use crate::{
+    lexer::Number,
+    nil,
+    node::{Ast, Node, NodeId},
+    symbol::Symbol,
+};
 
 pub fn no_less_than_n_params<T>(lst: &[T], n: usize) -> Result<(), String> {
     let x = lst.len();
@@ -27,8 +30,8 @@ pub fn exactly_n_params<T>(lst: &[T], n: usize) -> Result<(), String> {
     no_less_than_n_params(lst, n)
 }
 
-pub fn get_n_params(lst: Rc<RefCell<Node>>, n: usize) -> Result<Vec<Rc<RefCell<Node>>>, String> {
-    let result = vectorize(lst)?;
+pub fn get_n_params(ast: &Ast, lst: NodeId, n: usize) -> Result<Vec<NodeId>, String> {
+    let result = vectorize(ast, lst)?;
     exactly_n_params(&result, n)?;
     Ok(result)
 }
@@ -76,27 +79,14 @@ where
     })
 }
 
-pub fn vectorize(lst: Rc<RefCell<Node>>) -> Result<Vec<Rc<RefCell<Node>>>, String> {
+pub fn vectorize(ast: &Ast, lst: NodeId) -> Result<Vec<NodeId>, String> {
     let mut cur = lst;
     let mut result = Vec::new();
-    loop {
-        let next = {
-            let node = cur.borrow();
-            match &*node {
-                Node::Pair(car, cdr) => {
-                    result.push(car.clone());
-                    Some(cdr.clone())
-                }
-                _ => None,
-            }
-        };
-        if let Some(next_cur) = next {
-            cur = next_cur;
-        } else {
-            break;
-        }
+    while let Node::Pair(car, cdr) = *ast.get(cur) {
+        result.push(car);
+        cur = cdr;
     }
-    if *cur.as_ref().borrow() != nil!() {
+    if *ast.get(cur) != nil!() {
         return Err("Not a proper list".to_string());
     }
     Ok(result)
@@ -2,11 +2,11 @@ use std::{collections::HashMap, ffi::CString, process::Command};
 
 use relic::lexer::{Lexer, Number};
 use relic::logger::{LogLevel, set_log_level};
-use relic::node::Node;
+use relic::node::Ast;
 use relic::parser::Parse;
 use relic::preprocess::PreProcess;
 use relic::runtime::{DbgState, Runtime, RuntimeNode, StackMachine};
-use relic::symbol::Symbol;
+use relic::symbol::{Symbol, intern};
 use relic::{RT, rt_pop, rt_start};
 use relic::{
     compile::{self, CodeGen},
@@ -19,11 +19,12 @@ use std::{io::Write, process::Stdio};
 fn compile_and_load(input: &str, lib_name: &str) {
     let mut tokens = Lexer::new(input);
     let mut macros = HashMap::new();
+    let mut ast = Ast::new();
     let mut codegen = CodeGen::new_library(lib_name.to_string());
 
-    while let Ok(mut node) = Node::parse(&mut tokens) {
-        let node = node.preprocess(&mut macros).unwrap();
-        compile::compile(&node, &mut codegen, false).unwrap();
+    while let Ok(node) = ast.parse(&mut tokens) {
+        let node = ast.preprocess(node, &mut macros).unwrap();
+        compile::compile(&mut ast, node, &mut codegen, false).unwrap();
     }
     let c_code = codegen.to_string();
     std::fs::write(format!("/tmp/relic_{lib_name}.c"), c_code).unwrap();
@@ -61,7 +62,7 @@ fn compile_test_simple() {
     compile_and_load("(define x (+ 1 2))", "mylib");
 
     let x = get_value("x");
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     let val = runtime.get_number(x).unwrap();
     assert_eq!(val, Number::Int(3));
     runtime.clear();
@@ -71,55 +72,42 @@ fn compile_test_simple() {
 macro_rules! assert_eval_node {
     ($code:expr, $expected:expr) => {{
         let mut macros = HashMap::new();
-        let mut tokens = Lexer::new($code);
-        let mut node = Node::parse(&mut tokens).unwrap();
-        node = node.preprocess(&mut macros).unwrap();
-
-        node.jit_compile(true).unwrap();
-        let expected = {
-            let mut runtime = RT.write().unwrap();
-            runtime.new_node_with_gc($expected)
-        };
-        let index = rt_pop();
-        assert!(RT.read().unwrap().node_eq(index, expected));
+        let mut ast = Ast::new();
+        assert_eval_node!($code, $expected, ast, macros);
     }};
 
-    ($code:expr, $expected:expr, $macros:expr) => {{
+    // Macro templates are ids into the arena they were defined in, so call
+    // sites sharing `$macros` must share `$ast` as well.
+    ($code:expr, $expected:expr, $ast:expr, $macros:expr) => {{
         let mut tokens = Lexer::new($code);
-        let mut node = Node::parse(&mut tokens).unwrap();
-        node = node.preprocess(&mut $macros).unwrap();
+        let node = $ast.parse(&mut tokens).unwrap();
+        let node = $ast.preprocess(node, &mut $macros).unwrap();
 
-        node.jit_compile(true).unwrap();
+        $ast.jit_compile(node, true).unwrap();
         let expected = {
-            let mut runtime = RT.write().unwrap();
+            let runtime = RT.write();
             runtime.new_node_with_gc($expected)
         };
         let index = rt_pop();
-        assert!(RT.read().unwrap().node_eq(index, expected));
+        assert!(RT.read().node_eq(index, expected));
     }};
 }
 
 macro_rules! assert_eval_text {
     ($code:expr, $expected:expr) => {{
         let mut macros = HashMap::new();
-        let mut tokens = Lexer::new($code);
-        let mut node = Node::parse(&mut tokens).unwrap();
-        node = node.preprocess(&mut macros).unwrap();
-
-        node.jit_compile(true).unwrap();
-        let index = rt_pop();
-        let actual = RT.read().unwrap().display_node_idx(index);
-        assert_eq!(actual, $expected);
+        let mut ast = Ast::new();
+        assert_eval_text!($code, $expected, ast, macros);
     }};
 
-    ($code:expr, $expected:expr, $macros:expr) => {{
+    ($code:expr, $expected:expr, $ast:expr, $macros:expr) => {{
         let mut tokens = Lexer::new($code);
-        let mut node = Node::parse(&mut tokens).unwrap();
-        node = node.preprocess(&mut $macros).unwrap();
+        let node = $ast.parse(&mut tokens).unwrap();
+        let node = $ast.preprocess(node, &mut $macros).unwrap();
 
-        node.jit_compile(true).unwrap();
+        $ast.jit_compile(node, true).unwrap();
         let index = rt_pop();
-        let actual = RT.lock().unwrap().display_node_idx(index);
+        let actual = RT.read().display_node_idx(index);
         assert_eq!(actual, $expected)
     }};
 }
@@ -143,7 +131,7 @@ fn test_cycle_eval() {
     );
     assert_eval_text!("(define z2 (make-cycle2 (list 'a 'b 'c)))", "nil");
     assert_eval_text!("z2", "(a b c . #0#)");
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -154,7 +142,7 @@ fn test_set_car_eval() {
     assert_eval_text!("(define x '(1 2 3))", "nil");
     assert_eval_text!("(set-car! x 4)", "nil");
     assert_eval_text!("x", "(4 2 3)");
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -165,7 +153,7 @@ fn test_set_cdr_eval() {
     assert_eval_text!("(define x '(1 2 3))", "nil");
     assert_eval_text!("(set-cdr! x '(4 5 6))", "nil");
     assert_eval_text!("x", "(1 4 5 6)");
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -179,7 +167,7 @@ fn test_fact_eval() {
     );
     assert_eval_node!("(define x (fact 5 1))", RuntimeNode::Symbol(Symbol::Nil));
     assert_eval_node!("x", RuntimeNode::Number(Number::Int(120)));
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -193,7 +181,7 @@ fn test_or_eval() {
     assert_eval_text!("x1", "nil");
     assert_eval_text!("x2", "2");
     assert_eval_text!("x3", "1");
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -210,7 +198,7 @@ fn test_and_eval() {
     assert_eval_text!("x1", "t");
     assert_eval_text!("x2", "nil");
     assert_eval_text!("x3", "3");
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -238,16 +226,18 @@ fn test_cond_eval() {
     assert_eval_text!("x2", "2");
     assert_eval_text!("x3", "nil");
     assert_eval_text!("x4", "nil");
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
 #[test]
+#[serial]
 fn test_simple_expr_eval() {
     assert_eval_text!("(+ (* 1 2 3) (/ 3 4))", "6.75");
 }
 
 #[test]
+#[serial]
 fn test_simple_lambda_eval() {
     assert_eval_text!("((lambda (x y z) (- x ((lambda (x) z) y))) 3 4 1)", "2");
 }
@@ -278,7 +268,7 @@ fn test_lambda_pattern_matching_eval() {
     assert_eval_text!("x3", "2");
     assert_eval_text!("x4", "2");
     assert_eval_text!("x5", "t");
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -291,7 +281,7 @@ fn test_let_eval() {
         "(let ((x 1) (y 2)) (define z (+ x y)) z)",
         RuntimeNode::Number(Number::Int(3))
     );
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -310,7 +300,7 @@ fn test_set_eval() {
     assert_eval_node!("x", RuntimeNode::Number(Number::Int(3)));
     assert_eval_node!("x1", RuntimeNode::Number(Number::Int(1)));
     assert_eval_node!("x2", RuntimeNode::Number(Number::Int(2)));
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -331,7 +321,7 @@ fn test_fib_eval() {
         RuntimeNode::Symbol(Symbol::Nil)
     );
     assert_eval_text!("z", "(0 1 1 2 3 5 8 13 21 34 55)");
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -352,7 +342,7 @@ fn test_reverse_eval() {
         RuntimeNode::Symbol(Symbol::Nil)
     );
     assert_eval_text!("z", "(10 9 8 7 6 5 4 3 2 1)");
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -369,7 +359,7 @@ fn test_reverse_2_eval() {
         RuntimeNode::Symbol(Symbol::Nil)
     );
     assert_eval_text!("z", "(10 9 8 7 6 5 4 3 2 1)");
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -399,7 +389,7 @@ fn test_sqrt_eval() {
     );
     assert_eval_node!("(define z (sqrt 2))", RuntimeNode::Symbol(Symbol::Nil));
     assert_eval_node!("z", RuntimeNode::Number(Number::Float(1.4142156862745097)));
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -411,10 +401,10 @@ fn test_primitive() {
     assert_eval_node!("4.2", RuntimeNode::Number(Number::Float(4.2)));
     assert_eval_node!(
         "\"hello  \"",
-        RuntimeNode::Symbol(Symbol::User("hello  ".to_string()))
+        RuntimeNode::Symbol(Symbol::User(intern("hello  ")))
     );
 
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 #[test]
@@ -442,7 +432,7 @@ fn test_simple_arithmetic() {
     assert_eval_node!("(/ 6.0 3.0)", RuntimeNode::Number(Number::Float(2.0)));
     assert_eval_node!("(+ 1 2.0)", RuntimeNode::Number(Number::Float(3.0)));
     assert_eval_node!("(- 3.0 2)", RuntimeNode::Number(Number::Float(1.0)));
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -454,7 +444,7 @@ fn test_with_symbol() {
     assert_eval_node!("(- x 2)", RuntimeNode::Number(Number::Int(0)));
     assert_eval_node!("(* 3 x)", RuntimeNode::Number(Number::Int(6)));
     assert_eval_node!("(/ 6 x)", RuntimeNode::Number(Number::Int(3)));
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -467,7 +457,7 @@ fn test_nested_arithmetic() {
         "(* (/ 1 2) (+ 3 4))",
         RuntimeNode::Number(Number::Float(3.5))
     );
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -486,7 +476,7 @@ fn test_relational_operators() {
     assert_eval_node!("(>= 1 1)", RuntimeNode::Symbol(Symbol::T));
     assert_eval_node!("(>= 1 2)", RuntimeNode::Symbol(Symbol::Nil));
     assert_eval_node!("(>= 2 1)", RuntimeNode::Symbol(Symbol::T));
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -498,7 +488,7 @@ fn test_toplevel_symbol() {
     assert_eval_node!("-", RuntimeNode::Symbol(Symbol::Sub));
     assert_eval_node!("*", RuntimeNode::Symbol(Symbol::Mul));
     assert_eval_node!("/", RuntimeNode::Symbol(Symbol::Div));
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -535,7 +525,7 @@ fn test_define() {
     assert_eval_node!("(define y (+ x 1))", RuntimeNode::Symbol(Symbol::Nil));
     assert_eval_node!("x", RuntimeNode::Number(Number::Int(1)));
     assert_eval_node!("y", RuntimeNode::Number(Number::Int(2)));
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -544,23 +534,32 @@ fn test_define() {
 fn test_define_syntax_rule() {
     rt_start();
     let mut macros = HashMap::new();
+    let mut ast = Ast::new();
     assert_eval_node!(
         "(define-syntax-rule (macro1 x) (display 1) (+ x 1))",
         RuntimeNode::Symbol(Symbol::Nil),
+        ast,
         macros
     );
     assert_eval_node!(
         "(define-syntax-rule (macro2 x) (car x))",
         RuntimeNode::Symbol(Symbol::Nil),
+        ast,
+        macros
+    );
+    assert_eval_node!(
+        "(macro1 2)",
+        RuntimeNode::Number(Number::Int(3)),
+        ast,
         macros
     );
-    assert_eval_node!("(macro1 2)", RuntimeNode::Number(Number::Int(3)), macros);
     assert_eval_node!(
         "(macro2 '(1 2 3))",
         RuntimeNode::Number(Number::Int(1)),
+        ast,
         macros
     );
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -576,7 +575,7 @@ fn test_lambda() {
         "((lambda (x y) (+ x y)) 2 3)",
         RuntimeNode::Number(Number::Int(5))
     );
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -592,7 +591,7 @@ fn test_lambda_with_define() {
     );
     assert_eval_node!("(func 2)", RuntimeNode::Number(Number::Int(3)));
     assert_eval_node!("(func x)", RuntimeNode::Number(Number::Int(2)));
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -611,7 +610,7 @@ fn test_lambda_scope() {
         RuntimeNode::Symbol(Symbol::Nil)
     );
     assert_eval_node!("(h 1)", RuntimeNode::Number(Number::Int(2)));
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -625,7 +624,7 @@ fn test_lambda_pattern_matching() {
     );
     assert_eval_node!(
         "(f 'a 'b 3 4)",
-        RuntimeNode::Symbol(Symbol::User("a".to_string()))
+        RuntimeNode::Symbol(Symbol::User(intern("a")))
     );
 
     assert_eval_node!("(define (g . x) (car x))", RuntimeNode::Symbol(Symbol::Nil));
@@ -648,7 +647,7 @@ fn test_lambda_pattern_matching() {
     assert_eval_node!("(h 1 2)", RuntimeNode::Number(Number::Int(2)));
     assert_eval_node!("(h 1 't)", RuntimeNode::Symbol(Symbol::T));
 
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -670,7 +669,7 @@ fn test_function_call() {
         RuntimeNode::Symbol(Symbol::Nil)
     );
     assert_eval_node!("(a '(1 2 3))", RuntimeNode::Number(Number::Int(1)));
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -684,7 +683,7 @@ fn test_apply() {
     );
     assert_eval_node!("(apply f '(1 2 3))", RuntimeNode::Number(Number::Int(3)));
 
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -697,7 +696,7 @@ fn test_atom() {
     assert_eval_node!("(atom? (list 1 2 3))", RuntimeNode::Symbol(Symbol::Nil));
     assert_eval_node!("(atom? 'a)", RuntimeNode::Symbol(Symbol::T));
     assert_eval_node!("(atom? '())", RuntimeNode::Symbol(Symbol::T));
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -713,9 +712,38 @@ fn test_eq() {
     assert_eval_node!("(eq? '() '())", RuntimeNode::Symbol(Symbol::T));
     assert_eval_node!(
         "(eq? '(1 2 3) (list 1 2 3))",
+        RuntimeNode::Symbol(Symbol::Nil)
+    );
+    assert_eval_node!(
+        "(equal? '(1 2 3) (list 1 2 3))",
         RuntimeNode::Symbol(Symbol::T)
     );
-    let mut runtime = RT.write().unwrap();
+    assert_eval_node!(
+        "(equal? '(1 2 3) (list 1 2 4))",
+        RuntimeNode::Symbol(Symbol::Nil)
+    );
+    assert_eval_node!(
+        "((lambda (x) (eq? x x)) (list 1 2 3))",
+        RuntimeNode::Symbol(Symbol::T)
+    );
+    let runtime = RT.write();
+    runtime.clear();
+}
+
+#[test]
+#[serial]
+fn test_tail_call() {
+    rt_start();
+    // Deep enough to overflow the C stack without the trampoline.
+    assert_eval_node!(
+        "(define (count n) (if (= n 0) 'done (count (- n 1))))",
+        RuntimeNode::Symbol(Symbol::Nil)
+    );
+    assert_eval_node!(
+        "(count 200000)",
+        RuntimeNode::Symbol(Symbol::User(intern("done")))
+    );
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -728,7 +756,7 @@ fn test_number() {
     assert_eval_node!("(number? 'a)", RuntimeNode::Symbol(Symbol::Nil));
     assert_eval_node!("(number? '())", RuntimeNode::Symbol(Symbol::Nil));
     assert_eval_node!("(number? 'a)", RuntimeNode::Symbol(Symbol::Nil));
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -749,7 +777,7 @@ fn test_cond() {
         "(cond ((> 1 2) 1) ((> 1 2) 2))",
         RuntimeNode::Symbol(Symbol::Nil)
     );
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -760,7 +788,7 @@ fn test_and() {
     assert_eval_node!("(and)", RuntimeNode::Symbol(Symbol::T));
     assert_eval_node!("(and '() 2 3)", RuntimeNode::Symbol(Symbol::Nil));
     assert_eval_node!("(and 1 2 3)", RuntimeNode::Number(Number::Int(3)));
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -771,7 +799,7 @@ fn test_or() {
     assert_eval_node!("(or)", RuntimeNode::Symbol(Symbol::Nil));
     assert_eval_node!("(or '() 2 3)", RuntimeNode::Number(Number::Int(2)));
     assert_eval_node!("(or 1 2 3)", RuntimeNode::Number(Number::Int(1)));
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -788,7 +816,7 @@ fn test_fact() {
         RuntimeNode::Symbol(Symbol::Nil)
     );
     assert_eval_node!("(fact 5 1)", RuntimeNode::Number(Number::Int(120)));
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -809,7 +837,7 @@ fn test_list_package() {
     );
     assert_eval_text!("(map + '(1 2 3) '(3 2 1) '(3 3 3))", "(7 7 7)");
     assert_eval_text!("(append '((1 2) 3) '(4 5) '(6))", "((1 2) 3 4 5 6)");
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -827,7 +855,7 @@ fn test_fib() {
     assert_eval_node!("(fib 9)", RuntimeNode::Number(Number::Int(55)));
     assert_eval_node!("(import list)", RuntimeNode::Symbol(Symbol::Nil));
     assert_eval_text!("(map fib (iota 10))", "(1 1 2 3 5 8 13 21 34 55)");
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -844,7 +872,7 @@ fn test_set() {
         RuntimeNode::Symbol(Symbol::Nil)
     );
     assert_eval_node!("x", RuntimeNode::Number(Number::Int(3)));
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -855,7 +883,7 @@ fn test_set_car() {
     assert_eval_node!("(define x '(1 2 3))", RuntimeNode::Symbol(Symbol::Nil));
     assert_eval_node!("(set-car! x 4)", RuntimeNode::Symbol(Symbol::Nil));
     assert_eval_text!("x", "(4 2 3)");
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -873,7 +901,7 @@ fn test_set_cdr() {
     assert_eval_node!("(set! x (cons 2 3))", RuntimeNode::Symbol(Symbol::Nil));
     assert_eval_node!("(g x)", RuntimeNode::Symbol(Symbol::Nil));
     assert_eval_text!("x", "(2 . 1)");
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -887,7 +915,7 @@ fn test_begin() {
         RuntimeNode::Number(Number::Int(1))
     );
     assert_eval_node!("y", RuntimeNode::Number(Number::Int(2)));
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -903,7 +931,7 @@ fn test_let() {
         "(let ((x 1) (y 2)) (begin (define z (+ x y)) z))",
         RuntimeNode::Number(Number::Int(3))
     );
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -915,7 +943,7 @@ fn test_if() {
     assert_eval_node!("(if 0 2 3)", RuntimeNode::Number(Number::Int(2)));
     assert_eval_node!("(if 't 2 3)", RuntimeNode::Number(Number::Int(2)));
     assert_eval_node!("(if '() 2 3)", RuntimeNode::Number(Number::Int(3)));
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -953,7 +981,7 @@ fn test_reverse_list() {
     );
     assert_eval_text!("(reverse '(1 2 3 4))", "(4 3 2 1)");
     assert_eval_text!("(reverse-sugar '(1 2 3 4))", "(4 3 2 1)");
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -962,22 +990,26 @@ fn test_reverse_list() {
 fn test_delay() {
     rt_start();
     let mut macros = HashMap::new();
+    let mut ast = Ast::new();
     assert_eval_node!(
         "(define-syntax-rule (delay exp) (lambda () exp))",
         RuntimeNode::Symbol(Symbol::Nil),
+        ast,
         macros
     );
     assert_eval_node!(
         "(define (force delayed-object) (delayed-object))",
         RuntimeNode::Symbol(Symbol::Nil),
+        ast,
         macros
     );
     assert_eval_node!(
         "(force (delay 1))",
         RuntimeNode::Number(Number::Int(1)),
+        ast,
         macros
     );
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -1009,7 +1041,7 @@ fn test_cycle() {
         RuntimeNode::Symbol(Symbol::Nil)
     );
     assert_eval_text!("(make-cycle2 (list 'a 'b 'c))", "(a b c . #0#)");
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
 }
 
@@ -1038,7 +1070,7 @@ fn run_c_test() {
     assert!(status.success());
     rt_start();
     assert_eval_node!("(import test)", RuntimeNode::Symbol(Symbol::Nil));
-    let mut runtime = RT.write().unwrap();
+    let runtime = RT.write();
     runtime.clear();
     std::fs::remove_file("lib/test.relic").unwrap();
 }
@@ -1060,14 +1092,14 @@ fn debug_test() {
     rt_start();
     set_log_level(LogLevel::Debug);
     {
-        let mut runtime = RT.write().unwrap();
+        let runtime = RT.write();
         runtime.set_callback(test_callback);
     }
     assert_eval_node!("(define (f x) (* x 2))", RuntimeNode::Symbol(Symbol::Nil));
     assert_eval_node!("(breakpoint)", RuntimeNode::Symbol(Symbol::Nil));
     assert_eval_node!("(+ 1 (f 2))", RuntimeNode::Number(Number::Int(5)));
     {
-        let mut runtime = RT.write().unwrap();
+        let runtime = RT.write();
         runtime.clear();
     }
 }
@@ -1175,3 +1207,90 @@ CTRL-D
 "#
     );
 }
+
+#[test]
+fn test_save_restore_image() {
+    let warmup_path = "/tmp/relic_image_warmup.lisp";
+    let image_path = "/tmp/relic_test.img";
+    std::fs::write(
+        warmup_path,
+        r#"
+(define (f x) (* x 7))
+(define image-tbl '(10 20 30))
+"#,
+    )
+    .unwrap();
+
+    // Warm up and save an image.
+    let cmd = Command::new(env!("CARGO_BIN_EXE_relic"))
+        .args(["run", "-i", warmup_path, "--save-image", image_path])
+        .stdout(Stdio::piped())
+        .spawn()
+        .unwrap();
+    let out = cmd.wait_with_output().unwrap();
+    assert!(out.status.success());
+    assert_eq!(String::from_utf8(out.stdout).unwrap(), "result: nil\n");
+
+    // Restore the image in a fresh process: the warmed definitions must be
+    // usable without re-running the warm-up file.
+    let mut cmd = Command::new(env!("CARGO_BIN_EXE_relic"))
+        .args(["repl", "--restore-image", image_path])
+        .stdin(Stdio::piped())
+        .stdout(Stdio::piped())
+        .spawn()
+        .unwrap();
+    {
+        let mut stdin = cmd.stdin.take().unwrap();
+        stdin
+            .write_all(
+                br#"(f 6)
+image-tbl
+"#,
+            )
+            .unwrap();
+    }
+    let out = cmd.wait_with_output().unwrap();
+    assert!(out.status.success());
+    assert_eq!(
+        String::from_utf8(out.stdout).unwrap(),
+        r#"Relic REPL. Press Ctrl+D or type 'exit' to quit.
+= 42
+= (10 20 30)
+CTRL-D
+"#
+    );
+
+    // An image from another compiler version must be refused.
+    let stale_path = "/tmp/relic_stale.img";
+    std::fs::write(stale_path, "relic-image 0.0.0\njit_0000000000000000\n").unwrap();
+    let cmd = Command::new(env!("CARGO_BIN_EXE_relic"))
+        .args(["repl", "--restore-image", stale_path])
+        .stdin(Stdio::piped())
+        .stdout(Stdio::piped())
+        .stderr(Stdio::piped())
+        .spawn()
+        .unwrap();
+    let out = cmd.wait_with_output().unwrap();
+    assert!(!out.status.success());
+}
+
+// A compiled unit is one shared object for the whole process, but its
+// constant handles index per-context pools: every context that executes
+// the unit must run the startup block, or the later ones would index
+// pools they never filled.
+#[test]
+#[serial]
+fn test_unit_shared_across_contexts() {
+    for _ in 0..3 {
+        std::thread::spawn(|| {
+            relic::context_enter(relic::context_new(100));
+            rt_start();
+            let mut ast = Ast::new();
+            let node = ast.parse_str("(car '(10 20 30))").unwrap();
+            let node = ast.preprocess(node, &mut HashMap::new()).unwrap();
+            assert_eq!(relic::run_node(&mut ast, node).unwrap(), "10");
+        })
+        .join()
+        .unwrap();
+    }
+}
@@ -1,131 +1,172 @@
 #[cfg(test)]
 mod tests {
     use relic::lexer::{Lexer, Number};
-    use relic::node::Node;
+    use relic::node::{Ast, Node};
     use relic::parser::Parse;
-    use relic::symbol::{SpecialForm, Symbol};
-    use relic::{nil, vec_to_list};
+    use relic::symbol::{SpecialForm, Symbol, intern};
+    use relic::vec_to_list;
 
     #[test]
     fn test_parse_number() {
         let input = "42";
         let mut lexer = Lexer::new(input);
-        let result = Node::parse(&mut lexer);
-        assert_eq!(result, Ok(Node::Number(Number::Int(42))));
+        let mut ast = Ast::new();
+        let result = ast.parse(&mut lexer).unwrap();
+        assert_eq!(*ast.get(result), Node::Number(Number::Int(42)));
         let input = "3.14159265358979323846";
         let mut lexer = Lexer::new(input);
-        let result = Node::parse(&mut lexer);
-        assert_eq!(result, Ok(Node::Number(Number::Float(3.14159265358979323846))));
+        let result = ast.parse(&mut lexer).unwrap();
+        assert_eq!(
+            *ast.get(result),
+            Node::Number(Number::Float(3.14159265358979323846))
+        );
     }
 
     #[test]
     fn test_parse_symbol() {
         let input = "x";
         let mut lexer = Lexer::new(input);
-        let result = Node::parse(&mut lexer);
-        assert_eq!(result, Ok(Node::Symbol(Symbol::User("x".to_string()))));
+        let mut ast = Ast::new();
+        let result = ast.parse(&mut lexer).unwrap();
+        assert_eq!(*ast.get(result), Node::Symbol(Symbol::User(intern("x"))));
     }
 
     #[test]
     fn test_parse_add() {
         let input = "+";
         let mut lexer = Lexer::new(input);
-        let result = Node::parse(&mut lexer);
-        assert_eq!(result, Ok(Node::Symbol(Symbol::Add)));
+        let mut ast = Ast::new();
+        let result = ast.parse(&mut lexer).unwrap();
+        assert_eq!(*ast.get(result), Node::Symbol(Symbol::Add));
     }
 
     #[test]
     fn test_parse_sexp() {
         let input = "(+ 1 2)";
         let mut lexer = Lexer::new(input);
-        let result = Node::parse(&mut lexer);
-
-        assert_eq!(
-            result,
-            Ok(Node::Pair(
-                Node::Symbol(Symbol::Add).into(),
-                Node::Pair(
-                    Node::Number(Number::Int(1)).into(),
-                    Node::Pair(Node::Number(Number::Int(2)).into(), nil!().into()).into()
-                )
-                .into()
-            ))
-        );
+        let mut ast = Ast::new();
+        let result = ast.parse(&mut lexer).unwrap();
+
+        let add = ast.add(Node::Symbol(Symbol::Add));
+        let one = ast.add(Node::Number(Number::Int(1)));
+        let two = ast.add(Node::Number(Number::Int(2)));
+        let expected = vec_to_list!(ast, add, one, two);
+        assert!(ast.structural_eq(result, expected));
     }
 
     #[test]
     fn test_nested_expressions() {
         let input = "(+ (* 2 3) (- 5 1))";
         let mut lexer = Lexer::new(input);
-        let result = Node::parse(&mut lexer);
-
-        let ret = vec_to_list!(
-            Node::Symbol(Symbol::Add).into(),
-            vec_to_list!(
-                Node::Symbol(Symbol::Mul).into(),
-                Node::Number(Number::Int(2)).into(),
-                Node::Number(Number::Int(3)).into()
-            )
-            .into(),
-            vec_to_list!(
-                Node::Symbol(Symbol::Sub).into(),
-                Node::Number(Number::Int(5)).into(),
-                Node::Number(Number::Int(1)).into()
-            )
-            .into()
-        );
-        assert_eq!(result, Ok(ret));
+        let mut ast = Ast::new();
+        let result = ast.parse(&mut lexer).unwrap();
+
+        let mul = ast.add(Node::Symbol(Symbol::Mul));
+        let two = ast.add(Node::Number(Number::Int(2)));
+        let three = ast.add(Node::Number(Number::Int(3)));
+        let lhs = vec_to_list!(ast, mul, two, three);
+        let sub = ast.add(Node::Symbol(Symbol::Sub));
+        let five = ast.add(Node::Number(Number::Int(5)));
+        let one = ast.add(Node::Number(Number::Int(1)));
+        let rhs = vec_to_list!(ast, sub, five, one);
+        let add = ast.add(Node::Symbol(Symbol::Add));
+        let expected = vec_to_list!(ast, add, lhs, rhs);
+        assert!(ast.structural_eq(result, expected));
     }
 
     #[test]
     fn test_pair() {
         let input = "(1 . 2)";
         let mut lexer = Lexer::new(input);
-        let result = Node::parse(&mut lexer);
+        let mut ast = Ast::new();
+        let result = ast.parse(&mut lexer).unwrap();
 
-        assert_eq!(
-            result,
-            Ok(Node::Pair(
-                Node::Number(Number::Int(1)).into(),
-                Node::Number(Number::Int(2)).into()
-            ))
-        );
+        let one = ast.add(Node::Number(Number::Int(1)));
+        let two = ast.add(Node::Number(Number::Int(2)));
+        let expected = ast.pair(one, two);
+        assert!(ast.structural_eq(result, expected));
     }
 
     #[test]
     fn test_empty_sexp() {
         let input = "()";
         let mut lexer = Lexer::new(input);
-        let result = Node::parse(&mut lexer);
+        let mut ast = Ast::new();
+        let result = ast.parse(&mut lexer).unwrap();
 
-        assert_eq!(result, Ok(nil!()));
+        assert_eq!(result, ast.nil());
     }
 
     #[test]
     fn test_comment() {
         let input = "(;\n);;";
         let mut lexer = Lexer::new(input);
-        let result = Node::parse(&mut lexer);
+        let mut ast = Ast::new();
+        let result = ast.parse(&mut lexer).unwrap();
 
-        assert_eq!(result, Ok(nil!()));
+        assert_eq!(result, ast.nil());
     }
 
     #[test]
     fn test_quote() {
         let input = "'(() '())";
         let mut lexer = Lexer::new(input);
-        let result = Node::parse(&mut lexer);
+        let mut ast = Ast::new();
+        let result = ast.parse(&mut lexer).unwrap();
 
         // (quote (() (quote ())))
-        let ret = vec_to_list!(
-            Node::SpecialForm(SpecialForm::Quote).into(),
-            vec_to_list!(
-                nil!().into(),
-                vec_to_list!(Node::SpecialForm(SpecialForm::Quote).into(), nil!().into()).into()
-            )
-            .into()
-        );
-        assert_eq!(result, Ok(ret));
+        let inner_quote = ast.add(Node::SpecialForm(SpecialForm::Quote));
+        let nil = ast.nil();
+        let quoted_nil = vec_to_list!(ast, inner_quote, nil);
+        let body = vec_to_list!(ast, nil, quoted_nil);
+        let quote = ast.add(Node::SpecialForm(SpecialForm::Quote));
+        let expected = vec_to_list!(ast, quote, body);
+        assert!(ast.structural_eq(result, expected));
+    }
+
+    #[test]
+    fn test_optimize() {
+        use relic::optimize::Optimize;
+
+        // Nested arithmetic on literals folds to one number.
+        let mut ast = Ast::new();
+        let mut lexer = Lexer::new("(* 2 (+ 3 4))");
+        let result = ast.parse(&mut lexer).unwrap();
+        let result = ast.optimize(result);
+        let expected = ast.add(Node::Number(Number::Int(14)));
+        assert!(ast.structural_eq(result, expected));
+
+        // A statically-true condition prunes the if entirely.
+        let mut ast = Ast::new();
+        let mut lexer = Lexer::new("(if (< 1 2) x y)");
+        let result = ast.parse(&mut lexer).unwrap();
+        let result = ast.optimize(result);
+        let expected = ast.add(Node::Symbol(Symbol::User(intern("x"))));
+        assert!(ast.structural_eq(result, expected));
+
+        // Value-discarded literals disappear from begin; the symbol and the
+        // final expression stay.
+        let mut ast = Ast::new();
+        let mut lexer = Lexer::new("(begin 1 x (+ 1 2) y)");
+        let result = ast.parse(&mut lexer).unwrap();
+        let result = ast.optimize(result);
+        let mut lexer = Lexer::new("(begin x y)");
+        let expected = ast.parse(&mut lexer).unwrap();
+        assert!(ast.structural_eq(result, expected));
+
+        // Non-literal operands are left for the runtime.
+        let mut ast = Ast::new();
+        let mut lexer = Lexer::new("(+ x 1)");
+        let result = ast.parse(&mut lexer).unwrap();
+        assert_eq!(ast.optimize(result), result);
+
+        // A builtin passed as an argument is an operand, not an
+        // application: the `(+ 1 2)` tail of the operand list must not
+        // fold, or the call turns into the improper list `(f . 3)`.
+        let mut ast = Ast::new();
+        let mut lexer = Lexer::new("(f + 1 2)");
+        let result = ast.parse(&mut lexer).unwrap();
+        assert_eq!(ast.optimize(result), result);
     }
 
     #[test]
@@ -145,20 +186,9 @@ mod tests {
 
         for input in &inputs {
             let mut lexer = Lexer::new(input);
-            let result = Node::parse(&mut lexer);
+            let mut ast = Ast::new();
+            let result = ast.parse(&mut lexer);
             assert!(result.is_err());
         }
     }
-
-    // #[test]
-    // fn test_display() {
-    //     let input = "((* 1 (+ 2 3)) (4 5 . 6) (car (((7) 8)) cdr))";
-    //     let mut lexer = Lexer::new(input);
-    //     let result = Node::parse(&mut lexer);
-    //     let node: Rc<RefCell<Node>> = result.unwrap().into();
-    //     let mut runtime = Runtime::new(1);
-    //     node.load_to(&mut runtime).unwrap();
-    //     let node = runtime.pop();
-    //     assert_eq!(format!("{}", runtime.display_node_idx(node)), input);
-    // }
 }
@@ -2,6 +2,7 @@ use std::collections::HashMap;
 
 use relic::{
     lexer::Number,
+    node::Ast,
     runtime::{LoadToRuntime, Runtime, RuntimeNode, StackMachine},
     symbol::Symbol,
 };
@@ -45,6 +46,49 @@ fn gc_test_simple() {
     runtime.gc();
     // root, p1, p2, nil * 3
     assert_eq!(runtime.get_free(), 6);
+
+    let stats = runtime.gc_stats();
+    assert_eq!(stats.full_collections, 1);
+    assert_eq!(stats.live_nodes, 6);
+    // 3 pairs and 6 nils were allocated before the collection.
+    assert_eq!(stats.allocated_nodes, 9);
+}
+
+#[test]
+fn reserve_test() {
+    let mut runtime = Runtime::new(1);
+    runtime.reserve(100);
+    // 96 nodes fit in the reserved area without a single collection.
+    for _ in 0..32 {
+        Symbol::Nil.load_to(&mut runtime).unwrap();
+        Symbol::Nil.load_to(&mut runtime).unwrap();
+        runtime.new_pair();
+        runtime.pop();
+    }
+    assert_eq!(runtime.gc_stats().minor_collections, 0);
+    assert_eq!(runtime.gc_stats().full_collections, 0);
+}
+
+#[test]
+fn new_list_test() {
+    // Cover both the reserved fast path and the fallback for nurseries
+    // smaller than the spine.
+    with_different_gc_size(1, 20, |runtime| {
+        for i in (0..8).rev() {
+            Number::Int(i).load_to(runtime).unwrap();
+        }
+        runtime.new_list(8);
+        let list = runtime.pop();
+        assert_eq!(runtime.display_node_idx(list), "(0 1 2 3 4 5 6 7)");
+    });
+    // With room for the whole spine, building the list polls the GC at
+    // most once.
+    let mut runtime = Runtime::new(100);
+    for i in (0..8).rev() {
+        Number::Int(i).load_to(&mut runtime).unwrap();
+    }
+    runtime.new_list(8);
+    assert_eq!(runtime.gc_stats().minor_collections, 0);
 }
 
 #[test]
@@ -71,6 +115,26 @@ fn gc_test_linklst() {
     })
 }
 
+#[test]
+fn long_list_parse_test() {
+    // The parser drives an explicit frame stack, so a flat 100k-element
+    // list must load without overflowing the Rust call stack.
+    let mut runtime = Runtime::new(1000);
+    let length = 100_000;
+    let mut list_str = "(".to_string();
+    for i in 0..length {
+        list_str += &format!("{i} ");
+    }
+    list_str += ")";
+    list_str.load_to(&mut runtime).unwrap();
+    let mut cur = runtime.pop();
+    for i in 0..length {
+        let (car, cdr) = runtime.get_pair(cur).unwrap();
+        assert_eq!(runtime.get_number(car).unwrap(), Number::Int(i));
+        cur = cdr;
+    }
+}
+
 #[test]
 fn parse_test() {
     with_different_gc_size(1, 20, |runtime| {
@@ -92,6 +156,30 @@ fn parse_test() {
     })
 }
 
+#[test]
+fn context_isolation_test() {
+    // One isolated context per worker thread: globals defined in one must
+    // not be visible in the other, and both evaluate concurrently.
+    let workers: Vec<_> = (0..2)
+        .map(|i| {
+            std::thread::spawn(move || {
+                relic::context_enter(relic::context_new(100));
+                let runtime = relic::RT.write();
+                runtime.top_env();
+                runtime.global_set(i, (i as usize) | relic::runtime::FIXNUM_TAG);
+                assert_eq!(
+                    runtime.global_get(i),
+                    Some((i as usize) | relic::runtime::FIXNUM_TAG)
+                );
+                assert_eq!(runtime.global_get(1 - i), None);
+            })
+        })
+        .collect();
+    for worker in workers {
+        worker.join().unwrap();
+    }
+}
+
 #[test]
 fn cycle_test() {
     with_different_gc_size(1, 20, |runtime| {
@@ -121,8 +209,9 @@ fn cycle_test() {
         runtime.set_cdr(true, last, first).unwrap();
         runtime.remove_root("first");
 
-        let node = runtime.to_node(first, &mut HashMap::new());
-        assert_eq!(loop_str, format!("{}", node.borrow()));
+        let mut ast = Ast::new();
+        let node = runtime.to_node(first, &mut ast, &mut HashMap::new());
+        assert_eq!(loop_str, format!("{}", ast.display(node)));
 
         // node.load_to(runtime).unwrap();
         // runtime.gc();